@@ -0,0 +1,76 @@
+/**************************************************************
+ *                     bitfield.h
+ * 
+ *     Assignment: Homework 6 - Universal Machine Program
+ *     Authors: Katie Yang (zyang11) and Pamela Melgar (pmelga01)
+ *     Date: November 24, 2021
+ *
+ *     Purpose: Header-only replacements for the Bitpack_getu and 
+ *              Bitpack_newu functions of the course bitpack library. 
+ *              Being static inline, calls with constant widths and 
+ *              offsets (every call in the UM) fold into a shift and a 
+ *              mask wherever they are used.
+ *     
+ *     Success Output:
+ *              Depends on the function used
+ * 
+ *     Failure output:
+ *              Checked run-time errors
+ *                  
+ **************************************************************/
+
+#ifndef BITFIELD_H
+#define BITFIELD_H
+
+#include <stdint.h>
+#include <assert.h>
+
+/*
+* bitfield_mask
+* Purpose: To build a mask of width one bits starting at bit lsb
+* Input: the width and lsb of the field, width + lsb at most 64
+* Expected Output: the mask
+* Note: a width of 64 is allowed and shifting by 64 is avoided
+*/
+static inline uint64_t bitfield_mask(unsigned width, unsigned lsb)
+{
+    assert(width + lsb <= 64);
+
+    if (width == 0) {
+        return 0;
+    }
+    return (~(uint64_t)0 >> (64 - width)) << lsb;
+}
+
+/*
+* bitfield_getu
+* Purpose: To extract an unsigned field from a word
+* Input: the word, and the width and lsb of the field
+* Expected Output: the field's value, shifted down to bit 0
+* Note: same contract as Bitpack_getu
+*/
+static inline uint64_t bitfield_getu(uint64_t word, unsigned width, 
+                                     unsigned lsb)
+{
+    return (word & bitfield_mask(width, lsb)) >> (width == 0 ? 0 : lsb);
+}
+
+/*
+* bitfield_newu
+* Purpose: To replace an unsigned field of a word with a new value
+* Input: the word, the width and lsb of the field, and the value to store
+* Expected Output: the word with the field replaced
+* Note: it is a checked runtime error for value not to fit in width bits, 
+*       where Bitpack_newu raised Bitpack_Overflow
+*/
+static inline uint64_t bitfield_newu(uint64_t word, unsigned width, 
+                                     unsigned lsb, uint64_t value)
+{
+    uint64_t mask = bitfield_mask(width, lsb);
+
+    assert(width == 64 || (value >> width) == 0);
+
+    return (word & ~mask) | ((value << lsb) & mask);
+}
+
+#endif
@@ -21,20 +21,75 @@
 #include <string.h>
 #include <stdlib.h>
 #include <stdint.h>
+#include <signal.h>
+#include <sys/time.h>
 
 #include "excution.h"
 #include "read_file.h"
 #include "memory_manager.h"
 #include "register_manager.h"
 #include "instruction_retrieval.h"
-#include "seq.h"
-#include "bitpack.h"
+#include "predecode.h"
+#include "verifier.h"
+#include "threaded.h"
+#include "lockstep.h"
+#include "program_cache.h"
+#include "output_buffer.h"
+#include "input_buffer.h"
+#ifdef UM_JIT
+#include "jit.h"
+#endif
+#include "assert.h"
 
 #define BYTESIZE 8
 
 void print(Memory all_memory);
 void printRs(Registers all_registers);
 
+/*the opcodes a pair profile counts*/
+#define NUM_OPCODES (LV + 1)
+
+/*the engine this build runs, as lockstep reports name it*/
+#if defined(UM_JIT)
+#define ENGINE_NAME "jit"
+#elif defined(UM_THREADED)
+#define ENGINE_NAME "threaded"
+#else
+#define ENGINE_NAME "basic"
+#endif
+
+/*
+* struct Engine
+* Purpose: What the engine this build runs keeps between calls
+* Members: Program program - segment 0, decoded
+*          Jit jit - the translated blocks, in a JIT build
+*/
+struct Engine
+{
+    Program program;
+#ifdef UM_JIT
+    Jit jit;
+#endif
+};
+
+static int run_engine(void *cl, Memory all_segments, 
+                      Registers all_registers, uint32_t *counter, 
+                      Um_budget *budget);
+static int run_basic(Program program, Memory all_segments, 
+                     Registers all_registers, uint32_t *counter, 
+                     Um_budget *budget, 
+                     uint64_t pairs[NUM_OPCODES][NUM_OPCODES]);
+static void write_pair_profile(const char *path, 
+                               uint64_t pairs[NUM_OPCODES][NUM_OPCODES]);
+static void arm_watchdog(Um_budget *budget, double seconds);
+static void disarm_watchdog(void);
+static void report_limit(const Um_options *options, const Um_budget *budget,
+                         uint32_t counter);
+
+/*the budget the --max-seconds timer stops, and whether it has*/
+static Um_budget *watched_budget = NULL;
+static volatile sig_atomic_t timed_out = 0;
+
 
 /*
 * execute
@@ -47,32 +102,337 @@ void printRs(Registers all_registers);
 * Parameters: FILE *input: the file pointer to the input containing all 
 *             the word instructions that will be parsed and interpreted
 *             through the readFile module.
-* Returns: nothing, runs the program
-* Notes:
+*             const Um_options *options: the command-line options
+*             Memory_stats *stats: if not NULL, receives the memory 
+*             statistics as they stood when the program stopped
+* Returns: EXIT_SUCCESS if the program halted, EXIT_FAILURE if the 
+*          counter ran off the end of segment 0, LOCKSTEP_DIVERGED if 
+*          lockstep found the engine disagreeing with the reference, 
+*          UM_LIMIT_EXCEEDED if the program ran past its limits
+* Notes: the limits use the budget every engine already checks at load 
+*        program, so they cost nothing per instruction: the instruction 
+*        limit is the budget's limit, and the time limit is an interval 
+*        timer whose signal drops the budget's limit to 0
 */
-void excute(FILE *input)
+int excute(FILE *input, const Um_options *options, Memory_stats *stats)
 {
     /*Initialize memory and register manager to default state*/
     Memory all_segments = initialize_memory();
     Registers all_registers = initialize_registers();
 
-    /*Populate the 0th segment based on input*/
-    readFile(input, all_segments);
+    memory_use_hugepages(all_segments, options->hugepages);
+    memory_set_quota(all_segments, options->quota_words);
+    use_extensions(options->extensions);
+    output_setup(options->unbuffered, 
+                 options->async_output && options->lockstep == 0);
+    input_setup(options->map_input);
+
+    /*Populate the 0th segment and decode it once, from the program cache 
+      if it has this program; stores and loads keep the copy in step*/
+    struct Engine engine = { .program = NULL };
+    Cache_key key;
+
+    if (options->cache_dir != NULL) {
+        engine.program = cache_load(options->cache_dir, input, 
+                                    all_segments, &key);
+    }
+    if (engine.program != NULL) {
+        fclose(input);
+    }
+    else {
+        readFile(input, all_segments);
+        engine.program = program_new(all_segments);
+        if (options->cache_dir != NULL) {
+            cache_store(options->cache_dir, &key, all_segments, 
+                        engine.program);
+        }
+    }
+#ifdef UM_JIT
+    engine.jit = jit_new(all_segments);
+#endif
 
     uint32_t program_counter = 0; /*start program counter at beginning*/
+    Um_budget budget = { .executed = 0, .limit = UINT64_MAX };
+    int status;
+
+    if (options->max_instructions != 0) {
+        budget.limit = options->max_instructions;
+    }
+    if (options->max_seconds > 0 && options->lockstep == 0) {
+        arm_watchdog(&budget, options->max_seconds);
+    }
+
+    if (options->pair_profile != NULL) {
+        static uint64_t pairs[NUM_OPCODES][NUM_OPCODES];
+        status = run_basic(engine.program, all_segments, all_registers, 
+                           &program_counter, &budget, pairs);
+        write_pair_profile(options->pair_profile, pairs);
+    } 
+    else if (options->lockstep != 0) {
+        status = run_lockstep(run_engine, &engine, ENGINE_NAME, 
+                              all_segments, all_registers, 
+                              options->lockstep);
+    }
+    else {
+        status = run_engine(&engine, all_segments, all_registers, 
+                            &program_counter, &budget);
+    }
+    disarm_watchdog();
+    output_flush();
+    /*lockstep runs without limits, and its LOCKSTEP_DIVERGED shares
+      UM_PAUSED's value*/
+    if (status == UM_PAUSED && options->lockstep == 0) {
+        report_limit(options, &budget, program_counter);
+        status = UM_LIMIT_EXCEEDED;
+    }
+
+#ifdef UM_JIT
+    jit_free(&engine.jit);
+#endif
+    program_free(&engine.program);
+    if (stats != NULL) {
+        *stats = memory_stats(all_segments);
+    }
+
+    free_registers(all_registers);
+    free_segments(all_segments);
+    return status;
+}
+
+/*
+* run_engine
+* Purpose: To run the engine the build selected, in the form lockstep 
+*          takes
+* Parameters: void *cl - the struct Engine
+*             Memory all_segments - the segment manager
+*             Registers all_registers - the register manager
+*             uint32_t *counter - the program counter, as for run_basic
+*             Um_budget *budget - the instructions run and when to pause
+* Returns: EXIT_SUCCESS, EXIT_FAILURE or UM_PAUSED, as the engine does
+* Notes: the engine keeps its decoded program or blocks between calls
+*/
+static int run_engine(void *cl, Memory all_segments, 
+                      Registers all_registers, uint32_t *counter, 
+                      Um_budget *budget)
+{
+    struct Engine *engine = cl;
+
+#if defined(UM_JIT)
+    (void)all_segments;
+    return run_jit(engine->jit, all_registers, counter, budget);
+#elif defined(UM_THREADED)
+    return run_threaded(engine->program, all_segments, all_registers, 
+                        counter, budget);
+#else
+    return run_basic(engine->program, all_segments, all_registers, 
+                     counter, budget, NULL);
+#endif
+}
+
+/*
+* run_basic
+* Purpose: The portable execution engine. It runs the decoded program one 
+*          instruction at a time: words the verifier accepted through 
+*          execute_verified, and any others through execute_instruction, 
+*          which picks the handler with an if/else chain on the opcode and
+*          fails on an invalid one.
+* Parameters: Program program - segment 0, decoded
+*             Memory all_segments - the segment manager
+*             Registers all_registers - the register manager
+*             uint32_t *counter - the program counter to start from; on 
+*                       return it is one past the last instruction run
+*             Um_budget *budget - the instructions run so far and when 
+*                       to pause
+*             uint64_t pairs[][] - if not NULL, pairs[a][b] is incremented 
+*                       each time an opcode b instruction runs straight 
+*                       after the opcode a instruction just before it in 
+*                       segment 0, the pairs a superinstruction could fuse
+* Returns: EXIT_SUCCESS if the program halted, EXIT_FAILURE if the 
+*          counter ran off the end of segment 0, UM_PAUSED if the budget
+*          ran out
+* Notes: used unless the build selects the threaded or JIT engine, 
+*        and for every pair-profiling run
+*/
+static int run_basic(Program program, Memory all_segments, 
+                     Registers all_registers, uint32_t *counter, 
+                     Um_budget *budget, 
+                     uint64_t pairs[NUM_OPCODES][NUM_OPCODES])
+{
+    const struct Info *code = program_code(program);
+    const uint64_t *verified = program_verified(program);
+    uint32_t length = program_length(program);
+    uint32_t program_counter = *counter;
+    int status = EXIT_FAILURE; /*failure mode, out of bounds of $m[0]*/
+    uint32_t previous_op = 0;
+    uint32_t next_in_line = UINT32_MAX; /*no instruction has run yet*/
     
     /*Run through all instructions in segment0, note that counter may loop*/
-    while (program_counter < segmentlength(all_segments, 0)) {
-        uint32_t instruction = get_word(all_segments, 0, program_counter);
-        Info info = get_Info(instruction);
+    while (program_counter < length) {
+        const struct Info *info = &code[program_counter];
+        uint32_t op = info->op;
+
+        if (pairs != NULL && op < NUM_OPCODES) {
+            if (program_counter == next_in_line) {
+                pairs[previous_op][op]++;
+            }
+            previous_op = op;
+            next_in_line = program_counter + 1;
+        }
         program_counter++;
+        budget->executed++;
 
         /*program executer is passed in to update (in loop) if needed*/
-        instruction_executer(info, all_segments, all_registers, 
-                             &program_counter);
+        bool running;
+        if (is_verified(verified, program_counter - 1)) {
+            running = execute_verified(info, all_segments, all_registers, 
+                                       &program_counter);
+        }
+        else {
+            running = execute_instruction(info, all_segments, all_registers,
+                                          &program_counter);
+        }
+        if (!running) {
+            status = EXIT_SUCCESS;
+            break;
+        }
+
+        /*only these can change what segment 0 holds*/
+        if (op == SSTORE || op == LOADP || op == BCOPY || op == FILL) {
+            program_sync(program);
+            code = program_code(program);
+            verified = program_verified(program);
+            length = program_length(program);
+        }
+        if (op == LOADP && budget->executed >= budget->limit) {
+            status = UM_PAUSED;
+            break;
+        }
     }
 
-    free_registers(all_registers);
-    free_segments(all_segments);
-    exit(EXIT_FAILURE); /*failure mode, out of bounds of $m[0]*/
+    *counter = program_counter;
+    return status;
+}
+
+/*
+* write_pair_profile
+* Purpose: To save the opcode pair counts of a profiling run, one 
+*          "FIRST SECOND COUNT" line per pair that occurred, for 
+*          gen_superinstructions.sh to sum over a corpus of programs
+* Parameters: const char *path - the file to write
+*             uint64_t pairs[][] - the counts from run_basic
+* Returns: nothing
+* Notes: failing to open the file is a checked runtime error
+*/
+static void write_pair_profile(const char *path, 
+                               uint64_t pairs[NUM_OPCODES][NUM_OPCODES])
+{
+    FILE *out = fopen(path, "w");
+    assert(out != NULL);
+
+    for (unsigned first = 0; first < NUM_OPCODES; first++) {
+        for (unsigned second = 0; second < NUM_OPCODES; second++) {
+            if (pairs[first][second] != 0) {
+                fprintf(out, "%s %s %llu\n", opcode_name(first), 
+                        opcode_name(second), 
+                        (unsigned long long)pairs[first][second]);
+            }
+        }
+    }
+    fclose(out);
+}
+
+/*
+* on_alarm
+* Purpose: The SIGALRM handler of the --max-seconds timer
+* Parameters: int signum - SIGALRM
+* Returns: nothing
+* Notes: lowering the limit makes the engine pause at its next load 
+*        program, as if its instruction budget had run out
+*/
+static void on_alarm(int signum)
+{
+    (void)signum;
+    timed_out = 1;
+    if (watched_budget != NULL) {
+        watched_budget->limit = 0;
+    }
+}
+
+/*
+* arm_watchdog
+* Purpose: To stop the program once it has run for a wall-clock time
+* Parameters: Um_budget *budget - the budget the engine runs on
+*             double seconds - the time allowed, more than 0
+* Returns: nothing
+* Notes: the handler restarts interrupted reads, so a program waiting on 
+*        input keeps waiting and is stopped once it next loads a program
+*/
+static void arm_watchdog(Um_budget *budget, double seconds)
+{
+    assert(budget != NULL && seconds > 0);
+
+    struct sigaction action;
+    struct itimerval timer;
+
+    watched_budget = budget;
+    memset(&action, 0, sizeof(action));
+    action.sa_handler = on_alarm;
+    action.sa_flags = SA_RESTART;
+    sigemptyset(&action.sa_mask);
+    sigaction(SIGALRM, &action, NULL);
+
+    memset(&timer, 0, sizeof(timer));
+    timer.it_value.tv_sec = (time_t)seconds;
+    timer.it_value.tv_usec = (suseconds_t)((seconds - 
+                                            (double)(time_t)seconds) * 1e6);
+    if (timer.it_value.tv_sec == 0 && timer.it_value.tv_usec == 0) {
+        timer.it_value.tv_usec = 1;
+    }
+    setitimer(ITIMER_REAL, &timer, NULL);
+}
+
+/*
+* disarm_watchdog
+* Purpose: To cancel the --max-seconds timer, if it is set
+* Parameters: none
+* Returns: nothing
+*/
+static void disarm_watchdog(void)
+{
+    if (watched_budget == NULL) {
+        return;
+    }
+
+    struct itimerval timer;
+
+    memset(&timer, 0, sizeof(timer));
+    setitimer(ITIMER_REAL, &timer, NULL);
+    signal(SIGALRM, SIG_DFL);
+    watched_budget = NULL;
+}
+
+/*
+* report_limit
+* Purpose: To say on stderr which limit stopped the program, and where
+* Parameters: const Um_options *options - the limits
+*             const Um_budget *budget - the instructions run
+*             uint32_t counter - the program counter of the next 
+*                   instruction
+* Returns: nothing
+* Notes: the program's output has been flushed already, so the report 
+*        comes after it when both go to a terminal
+*/
+static void report_limit(const Um_options *options, const Um_budget *budget,
+                         uint32_t counter)
+{
+    if (timed_out) {
+        fprintf(stderr, "um: time limit of %g seconds reached", 
+                options->max_seconds);
+    }
+    else {
+        fprintf(stderr, "um: instruction limit of %llu reached", 
+                (unsigned long long)options->max_instructions);
+    }
+    fprintf(stderr, ": stopped at pc %u after %llu instructions\n", 
+            counter, (unsigned long long)budget->executed);
 }
@@ -18,21 +18,82 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include "memory_manager.h"
 
 #ifndef EXECUTION_H
 #define EXECUTION_H
 
+/*Exit status when the program is stopped for running past its limits*/
+#define UM_LIMIT_EXCEEDED 3
+
+/*
+* struct Um_options
+* Purpose: The run-time choices made on the um command line, handed from 
+*          the driver to the execution module
+* Members: bool hugepages - place segment 0 and large segments in 
+*                   transparent huge pages (--hugepages)
+*          uint64_t quota_words - the most words the program may have 
+*                   live at once, 0 for no limit (--quota)
+*          const char *pair_profile - if not NULL, run on the basic engine 
+*                   and write how often each opcode was executed straight 
+*                   after each other opcode to this file (--pair-profile)
+*          uint64_t lockstep - if not 0, run the engine and the reference 
+*                   interpreter side by side, comparing them at the first 
+*                   block boundary after every lockstep instructions 
+*                   (--lockstep)
+*          const char *cache_dir - if not NULL, load segment 0 decoded 
+*                   from the program cache in this directory, or add it 
+*                   there (--cache-dir)
+*          bool extensions - run opcodes 14 and 15 as the BCOPY and FILL 
+*                   extension instructions instead of failing (--ext)
+*          uint64_t max_instructions - if not 0, stop the program at the 
+*                   first load program after it has run this many 
+*                   instructions (--max-instructions)
+*          double max_seconds - if not 0, stop the program at the first 
+*                   load program after this much wall-clock time 
+*                   (--max-seconds)
+*          bool unbuffered - write each output character as it comes, 
+*                   rather than collecting them until input, the end or 
+*                   a full buffer (--unbuffered)
+*          bool map_input - map stdin instead of reading it when it is a 
+*                   regular file (--map-input)
+*          bool async_output - have a writer thread write the output 
+*                   while the program runs on (--async-output); not 
+*                   applied under lockstep
+*/
+typedef struct Um_options {
+    bool hugepages;
+    uint64_t quota_words;
+    const char *pair_profile;
+    uint64_t lockstep;
+    const char *cache_dir;
+    bool extensions;
+    uint64_t max_instructions;
+    double max_seconds;
+    bool unbuffered;
+    bool map_input;
+    bool async_output;
+} Um_options;
+
 /*
 * execute
 * Purpose: To pass in the opened file pointer to the beginning of the 
 *          input file containing UM word instructions, This module will 
 *          run the bulk of the program, including instruction executions
 * Input: a FILE * input pointer to the beginning of the file containing 
-*               UM word instsructions in order to run the program
-* Expected Output: nothihng, the program gets executed and is expected to 
-*                  run successfully
-* Note: 
+*               UM word instsructions in order to run the program, 
+*               the options chosen on the command line, and where to 
+*               leave the final memory statistics
+* Expected Output: EXIT_SUCCESS if the program halted, EXIT_FAILURE if it 
+*                  ran off the end of segment 0, LOCKSTEP_DIVERGED if 
+*                  lockstep found the engine disagreeing with the reference,
+*                  UM_LIMIT_EXCEEDED if it was stopped for running past 
+*                  max_instructions or max_seconds
+* Note: options must not be NULL, stats may be NULL. The limits are not 
+*       applied under lockstep, which runs on budgets of its own.
 */
-void excute(FILE *input);
+int excute(FILE *input, const Um_options *options, Memory_stats *stats);
 
 #endif 
\ No newline at end of file
@@ -0,0 +1,62 @@
+#! /bin/sh
+#
+#     gen_superinstructions.sh
+#
+#     Purpose: Writes superinstructions.h, the table of opcode pairs the 
+#              threaded engine fuses into a single handler, from the 
+#              pair counts that "um --pair-profile FILE" gathers.
+#
+#     Usage:   ./gen_superinstructions.sh N FILE... > superinstructions.h
+#              Sums the counts over every FILE (one per benchmark program)
+#              and keeps the N most frequent pairs whose first instruction 
+#              always falls through to the next: pairs starting with 
+#              SSTORE, LOADP or HALT are never fused, since those can 
+#              change segment 0 or leave the straight-line path.
+#
+#     Normally run through "make superinstructions".
+#
+
+if [ $# -lt 2 ]; then
+    echo "usage: $0 N pair-profile..." >&2
+    exit 1
+fi
+
+count=$1
+shift
+
+cat <<HEADER
+/**************************************************************
+ *                     superinstructions.h
+ *
+ *     GENERATED by gen_superinstructions.sh from the pair counts of:
+HEADER
+for file in "$@"; do
+    echo " *         $(basename "$file" .pairs)"
+done
+cat <<HEADER
+ *     Do not edit; run "make superinstructions" instead.
+ *
+ *     Purpose: The opcode pairs the threaded engine fuses, most 
+ *              frequent first, as X(FIRST, SECOND) with the counts 
+ *              they were chosen on.
+ *                  
+ **************************************************************/
+
+#ifndef SUPERINSTRUCTIONS_H
+#define SUPERINSTRUCTIONS_H
+
+#define SUPERINSTRUCTIONS(X) \\
+HEADER
+
+cat "$@" |
+    awk '$1 != "SSTORE" && $1 != "LOADP" && $1 != "HALT" \
+         { total[$1 " " $2] += $3 }
+         END { for (pair in total) print pair, total[pair] }' |
+    sort -k3,3nr -k1,1 -k2,2 |
+    head -n "$count" |
+    awk '{ printf "        X(%s, %s) /* %s */ \\\n", $1, $2, $3 }'
+
+cat <<FOOTER
+
+#endif
+FOOTER
@@ -0,0 +1,354 @@
+/**************************************************************
+ *                     idiom.c
+ * 
+ *     Assignment: Homework 6 - Universal Machine Program
+ *     Authors: Katie Yang (zyang11) and Pamela Melgar (pmelga01)
+ *     Date: November 24, 2021
+ *
+ *     Implementation for idiom.h
+ *
+ *     Purpose: Recognizes three loop shapes and runs them natively. All 
+ *              three end with the same counted branch back to the head:
+ *
+ *                  LV t, exit        t = where to go when done
+ *                  LV u, head        u = the loop head
+ *                  CMOV t, u, k      if k != 0, go round again
+ *                  LOADP z, t        jump (z holds 0)
+ *
+ *              fill words i-1 down to 0 (k = i):
+ *                  head: ADD i, i, neg1     i -= 1
+ *                        SSTORE s, i, v     m[s][i] = v
+ *                        <branch on i>
+ *              copy words i-1 down to 0 between segments (k = i):
+ *                  head: ADD i, i, neg1
+ *                        SLOAD w, s, i      w = m[s][i]
+ *                        SSTORE d, i, w     m[d][i] = w
+ *                        <branch on i>
+ *              scan up from i for a zero word (k = w):
+ *                  head: SLOAD w, s, i
+ *                        ADD i, i, one      i += 1
+ *                        <branch on w>
+ *
+ *              The fill and copy loops count down to zero so that they 
+ *              fit in the eight registers along with the branch. Only 
+ *              these exact instruction orders and operand orders are 
+ *              recognized; a loop written any other way (or mixed with 
+ *              other work) is interpreted as usual.
+ *     
+ *     Success Output:
+ *              Depends on the function used
+ * 
+ *     Failure output:
+ *              None
+ *                  
+ **************************************************************/
+
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "idiom.h"
+#include "assert.h"
+
+/*Instructions in each shape, counting the four-instruction branch*/
+#define FILL_LENGTH 6
+#define COPY_LENGTH 7
+#define SCAN_LENGTH 6
+#define BRANCH_LENGTH 4
+
+/*
+* is_add_in_place
+* Purpose: To match "ADD x, x, c", an in-place add of some register c
+* Parameters: const struct Info *in - the instruction
+*             uint8_t x - the register that must be added to
+* Returns: true if the instruction has that shape
+*/
+static bool is_add_in_place(const struct Info *in, uint8_t x)
+{
+    return in->op == ADD && in->rA == x && in->rB == x;
+}
+
+/*
+* is_branch
+* Purpose: To match the counted branch that closes every shape
+* Parameters: const struct Info *in - the first of the four instructions
+*             uint32_t head - the loop head it must jump back to
+*             uint8_t k - the register that must be tested
+* Returns: true if the four instructions are the canonical branch
+*/
+static bool is_branch(const struct Info *in, uint32_t head, uint8_t k)
+{
+    uint8_t t = in[0].rA;
+    uint8_t u = in[1].rA;
+
+    return in[0].op == LV && 
+           in[1].op == LV && in[1].value == head && u != t && 
+           in[2].op == CMOV && in[2].rA == t && in[2].rB == u && 
+           in[2].rC == k && 
+           in[3].op == LOADP && in[3].rC == t;
+}
+
+/*
+* clobbers
+* Purpose: To check whether a register the loop overwrites is one that 
+*          the loop needs to keep
+* Parameters: uint8_t changed - a register the loop writes
+*             const uint8_t *kept, int num_kept - registers the loop reads 
+*                       and relies on across iterations
+* Returns: true if changed is one of the kept registers
+*/
+static bool clobbers(uint8_t changed, const uint8_t *kept, int num_kept)
+{
+    for (int k = 0; k < num_kept; k++) {
+        if (changed == kept[k]) {
+            return true;
+        }
+    }
+    return false;
+}
+
+/*
+* idiom_in
+* Purpose: To match the instructions at head against each shape
+* Parameters: const struct Info *in - the decoded instructions from the 
+*                       head on
+*             uint32_t room - the number of instructions in in
+*             uint32_t head - the head's word index in segment 0
+* Returns: the idiom found, or IDIOM_NONE
+* Notes: the head must fit the 25-bit value of the branch's LV. The 
+*        branch temporaries t and u (and the copied word w) may share 
+*        registers with each other where the shape allows, but may not 
+*        overwrite the index, the segments, the constants or z.
+*/
+Idiom idiom_in(const struct Info *in, uint32_t room, uint32_t head)
+{
+    assert(in != NULL);
+    assert(room > 0);
+
+    if (in[0].op == ADD && room >= FILL_LENGTH && in[1].op == SSTORE) {
+        uint8_t i = in[0].rA, neg1 = in[0].rC;
+        uint8_t s = in[1].rA, v = in[1].rC;
+        const struct Info *br = &in[FILL_LENGTH - BRANCH_LENGTH];
+        uint8_t t = br[0].rA, u = br[1].rA;
+        uint8_t kept[] = { i, s, v, neg1, br[3].rB };
+
+        if (is_add_in_place(&in[0], i) && in[1].rB == i && 
+            is_branch(br, head, i) && i != s && i != v && i != neg1 && 
+            !clobbers(t, kept, 5) && !clobbers(u, kept, 5)) {
+            return IDIOM_FILL;
+        }
+    }
+
+    if (in[0].op == ADD && room >= COPY_LENGTH && in[1].op == SLOAD) {
+        uint8_t i = in[0].rA, neg1 = in[0].rC;
+        uint8_t w = in[1].rA, s = in[1].rB;
+        uint8_t d = in[2].rA;
+        const struct Info *br = &in[COPY_LENGTH - BRANCH_LENGTH];
+        uint8_t t = br[0].rA, u = br[1].rA;
+        uint8_t kept[] = { i, s, d, neg1, br[3].rB };
+
+        if (is_add_in_place(&in[0], i) && in[1].rC == i && 
+            in[2].op == SSTORE && in[2].rB == i && in[2].rC == w && 
+            is_branch(br, head, i) && i != s && i != d && i != neg1 && 
+            !clobbers(w, kept, 5) && !clobbers(t, kept, 5) && 
+            !clobbers(u, kept, 5)) {
+            return IDIOM_COPY;
+        }
+    }
+
+    if (in[0].op == SLOAD && room >= SCAN_LENGTH) {
+        uint8_t w = in[0].rA, s = in[0].rB, i = in[0].rC;
+        uint8_t one = in[1].rC;
+        const struct Info *br = &in[SCAN_LENGTH - BRANCH_LENGTH];
+        uint8_t t = br[0].rA, u = br[1].rA;
+        uint8_t kept[] = { i, s, one, br[3].rB };
+
+        if (is_add_in_place(&in[1], i) && is_branch(br, head, w) && 
+            !clobbers(w, kept, 4) && i != s && i != one && 
+            i != br[3].rB && t != w && u != w && 
+            !clobbers(t, kept, 4) && !clobbers(u, kept, 4)) {
+            return IDIOM_SCAN;
+        }
+    }
+
+    return IDIOM_NONE;
+}
+
+/*
+* idiom_at
+* Purpose: To match the instructions at head against each shape
+* Parameters: const struct Info *code - the decoded program
+*             uint32_t length - the number of instructions in code
+*             uint32_t head - the candidate loop head
+* Returns: the idiom found, or IDIOM_NONE
+*/
+Idiom idiom_at(const struct Info *code, uint32_t length, uint32_t head)
+{
+    assert(code != NULL);
+    assert(head < length);
+
+    return idiom_in(&code[head], length - head, head);
+}
+
+/*
+* finish_branch
+* Purpose: To leave the branch registers and program counter as the 
+*          loop's final, untaken branch does
+* Parameters: const struct Info *br - the first instruction of the branch
+*             uint32_t reg[] - the registers
+*             uint32_t *pc - the program counter
+* Returns: nothing
+* Notes: the final LOADP copies segment 0 onto itself, which does nothing
+*/
+static void finish_branch(const struct Info *br, uint32_t reg[], 
+                          uint32_t *pc)
+{
+    reg[br[0].rA] = br[0].value;
+    reg[br[1].rA] = br[1].value;
+    *pc = br[0].value;
+}
+
+/*
+* run_fill
+* Purpose: To run a recognized fill loop as one store of i words
+* Parameters: const struct Info *in - the loop head
+*             Memory memory, uint32_t reg[], uint32_t *pc - the machine
+*             uint64_t *executed - the instruction count to add to
+* Returns: true if it ran, false if a precondition failed
+*/
+static bool run_fill(const struct Info *in, Memory memory, uint32_t reg[], 
+                     uint32_t *pc, uint64_t *executed)
+{
+    uint32_t n = reg[in[0].rA];
+    uint32_t s = reg[in[1].rA], v = reg[in[1].rC];
+    const struct Info *br = &in[FILL_LENGTH - BRANCH_LENGTH];
+
+    if (reg[in[0].rC] != UINT32_MAX || reg[br[3].rB] != 0 || n == 0 || 
+        s == 0) {
+        return false;
+    }
+    struct Descriptor *seg = memory_find(memory, s);
+    if (seg == NULL || descriptor_shared(seg) || n > seg->length) {
+        return false;
+    }
+
+    for (uint32_t k = 0; k < n; k++) {
+        seg->base[k] = v;
+    }
+    reg[in[0].rA] = 0;
+    finish_branch(br, reg, pc);
+    *executed += (uint64_t)n * FILL_LENGTH;
+    return true;
+}
+
+/*
+* run_copy
+* Purpose: To run a recognized copy loop as one memmove of i words
+* Parameters: const struct Info *in - the loop head
+*             Memory memory, uint32_t reg[], uint32_t *pc - the machine
+*             uint64_t *executed - the instruction count to add to
+* Returns: true if it ran, false if a precondition failed
+* Notes: source and destination use the same index, so even a copy 
+*        within one segment cannot read a word it already wrote
+*/
+static bool run_copy(const struct Info *in, Memory memory, uint32_t reg[], 
+                     uint32_t *pc, uint64_t *executed)
+{
+    uint32_t n = reg[in[0].rA];
+    uint32_t s = reg[in[1].rB], d = reg[in[2].rA];
+    const struct Info *br = &in[COPY_LENGTH - BRANCH_LENGTH];
+
+    if (reg[in[0].rC] != UINT32_MAX || reg[br[3].rB] != 0 || n == 0 || 
+        d == 0) {
+        return false;
+    }
+    struct Descriptor *src = memory_find(memory, s);
+    struct Descriptor *dst = memory_find(memory, d);
+    if (src == NULL || dst == NULL || descriptor_shared(dst) || 
+        n > src->length || n > dst->length) {
+        return false;
+    }
+
+    uint32_t last = src->base[0]; /*the final iteration loads word 0*/
+    memmove(dst->base, src->base, (size_t)n * sizeof(uint32_t));
+    reg[in[0].rA] = 0;
+    reg[in[1].rA] = last;
+    finish_branch(br, reg, pc);
+    *executed += (uint64_t)n * COPY_LENGTH;
+    return true;
+}
+
+/*
+* run_scan
+* Purpose: To run a recognized scan loop as one search for a zero word
+* Parameters: const struct Info *in - the loop head
+*             Memory memory, uint32_t reg[], uint32_t *pc - the machine
+*             uint64_t *executed - the instruction count to add to
+* Returns: true if it ran, false if a precondition failed
+* Notes: a scan that finds no zero word runs every iteration but the one 
+*        that would load past the end, and stops at the head with i at the 
+*        segment's length. The next entry is then refused at once and the 
+*        interpreter fails the program there, as the loop would, without 
+*        scanning the segment again.
+*/
+static bool run_scan(const struct Info *in, Memory memory, uint32_t reg[], 
+                     uint32_t *pc, uint64_t *executed)
+{
+    uint32_t s = reg[in[0].rB], i = reg[in[0].rC];
+    const struct Info *br = &in[SCAN_LENGTH - BRANCH_LENGTH];
+
+    if (reg[in[1].rC] != 1 || reg[br[3].rB] != 0) {
+        return false;
+    }
+    struct Descriptor *seg = memory_find(memory, s);
+    if (seg == NULL || i >= seg->length) {
+        return false;
+    }
+
+    uint32_t k = i;
+    while (k < seg->length && seg->base[k] != 0) {
+        k++;
+    }
+    if (k == seg->length) {
+        reg[in[0].rA] = seg->base[k - 1];
+        reg[in[0].rC] = k;
+        reg[br[0].rA] = br[1].value;
+        reg[br[1].rA] = br[1].value;
+        *pc = br[1].value;
+        *executed += ((uint64_t)k - i) * SCAN_LENGTH;
+        return true;
+    }
+    reg[in[0].rA] = 0;
+    reg[in[0].rC] = k + 1;
+    finish_branch(br, reg, pc);
+    *executed += ((uint64_t)k - i + 1) * SCAN_LENGTH;
+    return true;
+}
+
+/*
+* idiom_run
+* Purpose: To run a recognized loop natively if its preconditions hold
+* Parameters: Idiom idiom - what idiom_at found at the loop head
+*             const struct Info *loop - the decoded loop head
+*             Memory memory - the segment manager
+*             uint32_t reg[] - the eight UM registers
+*             uint32_t *pc - the program counter, set to the loop's exit
+*             uint64_t *executed - increased by the instructions the loop 
+*                       stood for
+* Returns: true if the loop ran, false if the interpreter must run it
+* Notes: the branch values are read from the decoded program, so the 
+*        loop must still have the shape idiom_at saw
+*/
+bool idiom_run(Idiom idiom, const struct Info *loop, Memory memory, 
+               uint32_t reg[], uint32_t *pc, uint64_t *executed)
+{
+    assert(loop != NULL && memory != NULL && reg != NULL && pc != NULL);
+    assert(executed != NULL);
+
+    switch (idiom) {
+        case IDIOM_FILL: return run_fill(loop, memory, reg, pc, executed);
+        case IDIOM_COPY: return run_copy(loop, memory, reg, pc, executed);
+        case IDIOM_SCAN: return run_scan(loop, memory, reg, pc, executed);
+        default:         return false;
+    }
+}
@@ -0,0 +1,105 @@
+/**************************************************************
+ *                     idiom.h
+ * 
+ *     Assignment: Homework 6 - Universal Machine Program
+ *     Authors: Katie Yang (zyang11) and Pamela Melgar (pmelga01)
+ *     Date: November 24, 2021
+ *
+ *     Purpose: Interface for the idiom recognizer. It finds, in decoded 
+ *              segment 0, loops of a few canonical shapes that fill the 
+ *              start of a segment, copy the start of one segment to 
+ *              another, or scan for a zero word, and runs a whole such loop as one native 
+ *              memset/memmove/scan when its preconditions hold.
+ *     
+ *     Success Output:
+ *              Depends on the function used
+ * 
+ *     Failure output:
+ *              None; a loop whose preconditions fail is left to the 
+ *              interpreter
+ *                  
+ **************************************************************/
+
+#ifndef IDIOM_H
+#define IDIOM_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "memory_manager.h"
+#include "instruction_retrieval.h"
+
+/*The loop shapes the recognizer knows*/
+typedef enum Idiom {
+        IDIOM_NONE = 0, IDIOM_FILL, IDIOM_COPY, IDIOM_SCAN
+} Idiom;
+
+/*The most instructions any recognized loop spans*/
+#define IDIOM_MAX_LENGTH 7
+
+/*
+* idiom_may_start
+* Purpose: To rule out most words as loop heads without calling idiom_at
+* Input: the decoded program, its length and the word to look at
+* Expected Output: false if no recognized loop can start at head
+* Note: every shape starts with an add or a segmented load and ends in a 
+*       load program 6 or 7 words later
+*/
+static inline bool idiom_may_start(const struct Info *code, uint32_t length, 
+                                   uint32_t head)
+{
+    uint8_t op = code[head].op;
+
+    if ((op != ADD && op != SLOAD) || length - head < IDIOM_MAX_LENGTH - 1) {
+        return false;
+    }
+    return code[head + IDIOM_MAX_LENGTH - 2].op == LOADP || 
+           (length - head >= IDIOM_MAX_LENGTH && 
+            code[head + IDIOM_MAX_LENGTH - 1].op == LOADP);
+}
+
+/*
+* idiom_at
+* Purpose: To tell whether the instructions starting at a word of 
+*          segment 0 are one of the recognized loops, with that word as 
+*          the loop head
+* Input: the decoded program, its length and the word to look at
+* Expected Output: the idiom, or IDIOM_NONE
+* Note: only the shape and register use are checked here; register 
+*       values are checked by idiom_run each time the loop is entered
+*/
+Idiom idiom_at(const struct Info *code, uint32_t length, uint32_t head);
+
+/*
+* idiom_in
+* Purpose: idiom_at, for a caller that has decoded only the words from 
+*          the head on rather than all of segment 0
+* Input: the decoded instructions from the head on, how many there are 
+*        (IDIOM_MAX_LENGTH is enough) and the head's word index
+* Expected Output: the idiom, or IDIOM_NONE
+* Note: the JIT uses this when it translates a block
+*/
+Idiom idiom_in(const struct Info *in, uint32_t room, uint32_t head);
+
+/*
+* idiom_run
+* Purpose: To run a whole recognized loop natively, leaving the machine 
+*          exactly as the interpreter would after the loop's last branch
+* Input: the idiom, the decoded loop head (as from idiom_at), the Memory, 
+*        the eight register values, the program counter and the count of 
+*        instructions executed
+* Expected Output: true if the loop ran, with registers, memory and *pc 
+*                  updated and *executed increased by the instructions 
+*                  the interpreter would have run; false, with nothing 
+*                  changed, if a precondition did not hold and the 
+*                  interpreter must run the loop
+* Note: never fails the program. A loop that would go out of bounds, 
+*       touch an unmapped segment, store into segment 0 or a block shared 
+*       by load program, or run 2^32 times because its count starts at 0 
+*       is refused. A scan that finds no zero word runs up to the load 
+*       that would fail and leaves *pc at the head, where the next call 
+*       refuses it.
+*/
+bool idiom_run(Idiom idiom, const struct Info *loop, Memory memory, 
+               uint32_t reg[], uint32_t *pc, uint64_t *executed);
+
+#endif
@@ -0,0 +1,167 @@
+/**************************************************************
+ *                     input_buffer.c
+ *
+ *     Assignment: Homework 6 - Universal Machine Program
+ *     Authors: Katie Yang (zyang11) and Pamela Melgar (pmelga01)
+ *     Date: November 24, 2021
+ *
+ *     Purpose: Implementation for input_buffer.h. Standard input is read
+ *              straight from file descriptor 0 into one static buffer, or
+ *              mapped whole; stdio's stdin is not used.
+ *
+ *     Success Output:
+ *              Depends on the function used
+ *
+ *     Failure output:
+ *              None
+ *
+ **************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "input_buffer.h"
+#include "output_buffer.h"
+#include "assert.h"
+
+/*the size of the refill buffer, and so of each read(2)*/
+#define INPUT_BUFFER_BYTES (64 * 1024)
+
+static unsigned char buffer[INPUT_BUFFER_BYTES];
+
+struct Input_core input_core = { .next = NULL, .end = NULL,
+                                 .fd = STDIN_FILENO };
+
+/*
+* input_setup
+* Purpose: To map stdin when asked to and it is a regular file
+* Parameters: bool map - whether to try mapping
+* Returns: nothing
+* Notes: the mapping starts at stdin's current offset, so input a shell
+*        has already partly read is taken from where it left off. The
+*        mapping lasts until the process exits.
+*/
+void input_setup(bool map)
+{
+    struct stat st;
+
+    input_core = (struct Input_core){ .next = NULL, .end = NULL,
+                                      .fd = STDIN_FILENO };
+    if (!map || fstat(STDIN_FILENO, &st) != 0 || !S_ISREG(st.st_mode)) {
+        return;
+    }
+
+    off_t offset = lseek(STDIN_FILENO, 0, SEEK_CUR);
+    if (offset < 0 || offset >= st.st_size) {
+        return;
+    }
+
+    void *bytes = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE,
+                       STDIN_FILENO, 0);
+    if (bytes == MAP_FAILED) {
+        return;
+    }
+    madvise(bytes, (size_t)st.st_size, MADV_SEQUENTIAL);
+    input_core = input_over((const unsigned char *)bytes + offset,
+                            (size_t)(st.st_size - offset));
+}
+
+/*
+* input_over
+* Purpose: To make an input of characters already in memory
+* Parameters: const unsigned char *bytes, size_t length - the characters
+* Returns: the Input_core, which never refills
+*/
+struct Input_core input_over(const unsigned char *bytes, size_t length)
+{
+    assert(bytes != NULL || length == 0);
+
+    struct Input_core input = { .next = bytes, .end = bytes, .fd = -1 };
+
+    if (length != 0) {
+        input.end = bytes + length;
+    }
+    return input;
+}
+
+/*
+* fill
+* Purpose: To read more of the input into the buffer
+* Parameters: none
+* Returns: true if there are characters on hand again, false at the end
+*          of input
+* Notes: the program's output is flushed first, so a prompt is seen
+*        before the read waits for its answer. The end of input sticks,
+*        as it does for stdio's stdin.
+*/
+static bool fill(void)
+{
+    ssize_t n;
+
+    output_flush();
+    if (input_core.fd < 0) {
+        return false;
+    }
+    do {
+        n = read(input_core.fd, buffer, sizeof(buffer));
+    } while (n < 0 && errno == EINTR);
+
+    if (n <= 0) {
+        input_core.fd = -1;
+        input_core.next = input_core.end = NULL;
+        return false;
+    }
+    input_core.next = buffer;
+    input_core.end = buffer + n;
+    return true;
+}
+
+/*
+* input_refill
+* Purpose: To refill the input and take a character from it
+* Parameters: none
+* Returns: the character, or all ones at the end of input
+*/
+uint32_t input_refill(void)
+{
+    if (!fill()) {
+        return ~(uint32_t)0;
+    }
+    return *input_core.next++;
+}
+
+/*
+* input_bytes
+* Purpose: To take up to count characters of input
+* Parameters: unsigned char *to - where they go
+*             size_t count - how many are wanted
+* Returns: how many were taken
+* Notes: refills as often as it must, so a short count means the input
+*        has ended
+*/
+size_t input_bytes(unsigned char *to, size_t count)
+{
+    assert(to != NULL || count == 0);
+
+    size_t taken = 0;
+
+    while (taken < count) {
+        if (input_core.next == input_core.end && !fill()) {
+            break;
+        }
+
+        size_t n = (size_t)(input_core.end - input_core.next);
+        if (n > count - taken) {
+            n = count - taken;
+        }
+        memcpy(to + taken, input_core.next, n);
+        input_core.next += n;
+        taken += n;
+    }
+    return taken;
+}
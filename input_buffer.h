@@ -0,0 +1,112 @@
+/**************************************************************
+ *                     input_buffer.h
+ *
+ *     Assignment: Homework 6 - Universal Machine Program
+ *     Authors: Katie Yang (zyang11) and Pamela Melgar (pmelga01)
+ *     Date: November 24, 2021
+ *
+ *     Purpose: Interface for input_buffer, where the IN instruction of
+ *              every engine takes its characters from. The machine owns a
+ *              buffer that is refilled from standard input with large
+ *              read(2) calls, or, when stdin is a regular file and the
+ *              caller asks for it, the whole file is mapped and IN only
+ *              moves a pointer. Output is flushed before a refill, since
+ *              that is where the program may wait.
+ *
+ *     Success Output:
+ *              Depends on the function used
+ *
+ *     Failure output:
+ *              None; a read error ends the input, as fgetc's EOF did
+ *
+ **************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifndef INPUT_BUFFER_H
+#define INPUT_BUFFER_H
+
+/*
+* struct Input_core
+* Purpose: Where the next input character comes from
+* Members: const unsigned char *next - the next unread character
+*          const unsigned char *end - the end of the characters on hand
+*          int fd - the file descriptor refills read from, -1 once input
+*                   has ended or when the characters on hand are all
+*                   there is
+* Notes: The layout is visible so that input_char can be inlined into the
+*        engines, and so that lockstep can give each of its machines an
+*        input of its own; other clients should go through the functions
+*/
+struct Input_core
+{
+    const unsigned char *next;
+    const unsigned char *end;
+    int fd;
+};
+
+/*the input of the machine*/
+extern struct Input_core input_core;
+
+
+/*
+* input_setup
+* Purpose: To choose how standard input is read
+* Input: true to map stdin if it is a regular file (--map-input)
+* Expected Output: none
+* Note: call before anything is read. stdin that is not a regular file, or
+*       that cannot be mapped, is read with read(2) either way.
+*/
+void input_setup(bool map);
+
+
+/*
+* input_over
+* Purpose: To make an input that reads from characters in memory
+* Input: the characters and their number
+* Expected Output: an Input_core to put in input_core
+* Note: the characters must outlive every read of it
+*/
+struct Input_core input_over(const unsigned char *bytes, size_t length);
+
+
+/*
+* input_refill
+* Purpose: To get the next character when none are on hand
+* Input: none
+* Expected Output: the character, or all ones at the end of input
+* Note: only input_char calls it
+*/
+uint32_t input_refill(void);
+
+
+/*
+* input_bytes
+* Purpose: To take a block of input characters at once
+* Input: where to put them, and how many are wanted
+* Expected Output: how many were taken, fewer than count only at the end
+*                  of input
+* Note: none
+*/
+size_t input_bytes(unsigned char *to, size_t count);
+
+
+/*
+* input_char
+* Purpose: To take one input character, as the IN instruction does
+* Input: none
+* Expected Output: the character, or all ones at the end of input
+* Note: none
+*/
+static inline uint32_t input_char(void)
+{
+    if (input_core.next != input_core.end) {
+        return *input_core.next++;
+    }
+    return input_refill();
+}
+
+#endif
@@ -22,7 +22,8 @@
  *              Conditional Move, Segmented Load, Segmented Store, 
  *              Addition, Multiplication, Division, Bitwise NAND, 
  *              Halt, Map Segment, Unmap Segment, Output,  Input, 
- *              Load Program, and Load Value
+ *              Load Program, and Load Value, and under --ext 
+ *              Block Copy (with bulk output and input) and Fill
  *                  
  **************************************************************/
 
@@ -32,51 +33,21 @@
 #include <stdint.h>
 
 #include "instruction_retrieval.h"
-#include "bitpack.h"
+#include "output_buffer.h"
+#include "input_buffer.h"
+#include "bitfield.h"
 #include "assert.h" 
 
-typedef enum Um_opcode {
-        CMOV = 0, SLOAD, SSTORE, ADD, MUL, DIV,
-        NAND, HALT, ACTIVATE, INACTIVATE, OUT, IN, LOADP, LV
-} Um_opcode;
-
 #define num_registers 8
 #define two_pow_32 4294967296
 uint32_t MIN = 0;   
 uint32_t MAX = 255;
 
-/*
-* struct Info
-* Purpose: To combine all of the parsed information retrieved from an 
-*          interpreted instruction into a single type. This way the 
-*          Info struct can be passed around without needing to call 
-*          other functions to extract this information. The client 
-*          will have to create an instance of this struct and then pass it
-*          through to the execution of instructions once it is initialized
-* Members: uint32_t op - this value represents the last 4 bits of the 
-*                        word instruction, or the opcode, indicating which 
-*                        of the defined instructions this word is meant to 
-*                        execute.
-*          uint32_t rA - this value is the index of the first register 
-*                        specified in the word instruction, LSB 6. 
-*          uint32_t rB - this value is the index of the second register 
-*                        specified in the word instruction, LSB 3. 
-*          uint32_t rC - this value is the index of the third register 
-*                        specified in the word instruction, LSB 0.
-*          uint32_t value - this value is for the special case ('load value')
-*                           instruction when the first 25 bits are dedicated 
-*                           for a value to load into a register. 
-* Notes: The client cannot see this struct Info implmentation, and will 
-*        only have access to a pointer to this struct
-*/
-struct Info
-{
-    uint32_t op;
-    uint32_t rA;
-    uint32_t rB;
-    uint32_t rC;
-    uint32_t value;
-};
+/*whether opcodes 14 and 15 run as BCOPY and FILL (--ext)*/
+static bool extensions = false;
+
+/*characters moved per stdio call by BCOPY's write and read functions*/
+#define BULK_CHUNK 4096
 
 /*Helper functions used throughout the specified instructino executions*/
 
@@ -116,8 +87,11 @@ void load_program(struct Info info, Registers all_registers,
                   Memory all_segments, uint32_t *counter);
 
 /*performs halt program --- instruction: 7*/
-void halt_program(struct Info *info, Registers all_registers, 
-                  Memory all_segments);
+bool halt_program(Registers all_registers, Memory all_segments);
+
+/*performs block copy and fill --- extension instructions: 14-15*/
+void bulk_memory(struct Info info, Registers all_registers, 
+                 Memory all_segments, uint32_t bulk_code);
 
 
 /*
@@ -138,30 +112,81 @@ struct Info *get_Info(uint32_t instruction)
     struct Info *info = malloc(sizeof(struct Info));
     assert(info != NULL); /*Check if heap allocation successful*/
 
-    uint32_t op = (int)Bitpack_getu(instruction, 4, 28);
-    info->op = op;
+    decode_instruction(instruction, info);
+    return info;
+}
+
+
+/*
+* decode_instruction
+* Purpose: To unpack a uint32_t instruction into an Info struct that the 
+*          caller owns, without going through the heap
+* Parameters: uint32_t instruction - the 32-bit word instruction
+*             struct Info *info - where the unpacked fields are stored
+* Returns: nothing
+* Notes: the field widths are constants, so the inline bitfield_getu 
+*        calls compile to plain shifts and masks. Unused fields are zeroed 
+*        so that decoded programs compare equal word for word. BCOPY keeps 
+*        its function whether or not the extensions are on.
+*/
+void decode_instruction(uint32_t instruction, struct Info *info)
+{
+    assert(info != NULL);
+
+    info->op = bitfield_getu(instruction, 4, 28);
 
-    if (op != 13){
-        info->rA = (int)Bitpack_getu(instruction, 3, 6);
-        info->rB = (int)Bitpack_getu(instruction, 3, 3);
-        info->rC = (int)Bitpack_getu(instruction, 3, 0);
+    if (info->op != LV) {
+        info->rA = bitfield_getu(instruction, 3, 6);
+        info->rB = bitfield_getu(instruction, 3, 3);
+        info->rC = bitfield_getu(instruction, 3, 0);
+        info->value = info->op == BCOPY ? bitfield_getu(instruction, 4, 9) 
+                                        : 0;
     }
     else {
-        info->rA = (int)Bitpack_getu(instruction, 3, 25);
-        info->value = (int)Bitpack_getu(instruction, 25, 0);
+        info->rA = bitfield_getu(instruction, 3, 25);
+        info->rB = 0;
+        info->rC = 0;
+        info->value = bitfield_getu(instruction, 25, 0);
     }
-    return info;
 }
 
 
 /*
 * instruction_executer
-* Purpose: To run a defined instruction 0-13 based on the opcode of 
-*          the Info struct. To seperate the functions that interpret the 
-*          uint32_t word vs. the function that actually executes the 
+* Purpose: To run the instruction held in a heap-allocated Info struct 
+*          from get_Info, and then free it
+* Parameters: Info info - a struct pointer from get_Info
+*             Memory all_segments - a reference to the segment manager 
+*                       used throughout the program.
+*             Registers all_registers - a reference to the register manager 
+*                       used throughout the program.
+*             uint32_t *counter - a reference to the program counter 
+*                       that is keeping track of which instruction to 
+*                       execute in segment 0.
+* Returns: true if the program should keep running, false once it has 
+*          executed a halt instruction
+* Notes: struct pointer info must be non-NULL, and is freed either way
+*/
+bool instruction_executer(Info info, Memory all_segments, 
+                          Registers all_registers, uint32_t *counter) 
+{
+    assert(info != NULL);
+
+    bool running = execute_instruction(info, all_segments, all_registers, 
+                                       counter);
+    free(info);
+    return running;
+}
+
+/*
+* execute_instruction
+* Purpose: To run a defined instruction 0-13 (or 0-15 with the 
+*          extensions on) based on the opcode of the Info struct. To 
+*          seperate the functions that interpret the uint32_t word 
+*          vs. the function that actually executes the 
 *          proper instruction or handles invalid instructions.
-* Parameters: Info info - a struct pointer to the information containing 
-*                         the seperated unpacked instruction values.
+* Parameters: const struct Info *info - the seperated unpacked instruction 
+*                         values. It is only read.
 *             Memory all_segments - a reference to the segment manager 
 *                       used throughout the program.
 *             Registers all_registers - a reference to the register manager 
@@ -169,14 +194,15 @@ struct Info *get_Info(uint32_t instruction)
 *             uint32_t *counter - a reference to the program counter 
 *                       that is keeping track of which instruction to 
 *                       execute in segment 0.
-* Returns: nothing - executes an instruction and ends
+* Returns: true if the program should keep running, false once it has 
+*          executed a halt instruction
 * Notes: struct pointer info must be non-NULL
 *        all_segments must not be NULL
 *        all_registers must be non-NULL 
 *        reference to program counter must be non-NULL
 */
-void instruction_executer(Info info, Memory all_segments, 
-                          Registers all_registers, uint32_t *counter) 
+bool execute_instruction(const struct Info *info, Memory all_segments, 
+                         Registers all_registers, uint32_t *counter) 
 {
     assert(info != NULL);
     assert(all_segments != NULL);
@@ -187,7 +213,7 @@ void instruction_executer(Info info, Memory all_segments,
     
     /*We want a halt instruction to execute quicker*/
     if (code == HALT) {
-        halt_program(info, all_registers, all_segments);
+        return halt_program(all_registers, all_segments);
     }
 
     /*Rest of instructions*/
@@ -221,43 +247,80 @@ void instruction_executer(Info info, Memory all_segments,
     else if (code == LV) {
         load_val(*info, all_registers);
     }
+    else if ((code == BCOPY || code == FILL) && extensions) {
+        bulk_memory(*info, all_registers, all_segments, code);
+    }
     else {
        exit(EXIT_FAILURE);
     }
 
-    free(info);
-    return;
+    return true;
+}
+
+/*
+* opcode_name
+* Purpose: To give the name of an opcode, as pair profiles and lockstep 
+*          reports write it
+* Parameters: uint32_t op - the opcode
+* Returns: the name of the Um_opcode, or "invalid"
+* Notes: the names are string literals, never freed
+*/
+const char *opcode_name(uint32_t op)
+{
+    static const char *const names[] = {
+            "CMOV", "SLOAD", "SSTORE", "ADD", "MUL", "DIV", "NAND", "HALT",
+            "ACTIVATE", "INACTIVATE", "OUT", "IN", "LOADP", "LV",
+            "BCOPY", "FILL"
+    };
+
+    return opcode_valid(op) ? names[op] : "invalid";
+}
+
+/*
+* use_extensions
+* Purpose: To turn opcodes 14 and 15 into BCOPY and FILL, or back into 
+*          invalid instructions
+* Parameters: bool enable - whether the extensions are on
+* Returns: nothing
+* Notes: one setting for the whole process, like the machine it runs
+*/
+void use_extensions(bool enable)
+{
+    extensions = enable;
+}
+
+/*
+* opcode_valid
+* Purpose: To tell the engines and lockstep which opcodes they may run
+* Parameters: uint32_t op - an opcode
+* Returns: true if execute_instruction runs it rather than failing
+* Notes: none
+*/
+bool opcode_valid(uint32_t op)
+{
+    return op <= LV || (extensions && op <= FILL);
 }
 
 /*
 * halt_program
-* Purpose: A helper function that will run the halt instruction and 
-*          perform the necessary memory freeing in order to have a successful 
-*          termination of the program
-* Parameters: Info info - a struct pointer to the information containing 
-*                         the seperated unpacked instruction values.
-*             Registers all_registers - a reference to the register manager 
+* Purpose: A helper function that will run the halt instruction, telling 
+*          the caller to stop. The execution module owns the machine, so 
+*          it releases the registers and segments (and reports on them) 
+*          once the loop has stopped.
+* Parameters: Registers all_registers - a reference to the register manager 
 *                       used throughout the program.
 *             Memory all_segments - a reference to the segment manager 
 *                       used throughout the program.
-* Returns: nothing - executes an instruction and ends
-* Notes: struct pointer info must be non-NULL
-*        all_segments must not be NULL
+* Returns: false - the program must not keep running
+* Notes: all_segments must not be NULL
 *        all_registers must be non-NULL 
 */
-void halt_program(struct Info *info, Registers all_registers, 
-                  Memory all_segments)
+bool halt_program(Registers all_registers, Memory all_segments)
 {
-    assert(info != NULL);
     assert(all_registers != NULL);
     assert(all_segments != NULL);
 
-    free(info);
-    free_registers(all_registers);
-    free_segments(all_segments);
-
-
-    exit(EXIT_SUCCESS);
+    return false;
 }
 
 /*
@@ -474,7 +537,7 @@ void output(struct Info info, Registers all_registers)
     assert(val >= MIN);
     assert(val <= MAX);
 
-    printf("%c", val);
+    output_char(val);
 }
 
 /*
@@ -497,7 +560,7 @@ void input(struct Info info, Registers all_registers)
     
     uint32_t rC = info.rC;
 
-    uint32_t input_value = (uint32_t)fgetc(stdin);
+    uint32_t input_value = input_char();
     uint32_t all_ones = ~0;
     
     /*Check if input value is EOF...aka: -1*/
@@ -582,3 +645,122 @@ void segmented_store(struct Info info, Registers all_registers,
 
     set_word(all_segments, rA_val, rB_val, rC_val);
 }
+
+/*
+* bulk_memory
+* Purpose: A helper function that runs the block copy and fill extension 
+*          instructions, whose segments and offsets come in register pairs
+* Parameters: Info info - a struct containing the seperated unpacked 
+*                         instruction values.
+*             Registers all_registers - a reference to the register manager 
+*                       used throughout the program.
+*             Memory all_segments - a reference to the memory manager used 
+*                       throughout the program
+*             uint32_t bulk_code - BCOPY or FILL
+* Returns: nothing - executes an instruction and ends
+* Notes: all_registers must be non-NULL. The memory manager checks the 
+*        segments and ranges. A BCOPY function other than copy, write or 
+*        read fails like an invalid opcode.
+*/
+void bulk_memory(struct Info info, Registers all_registers, 
+                 Memory all_segments, uint32_t bulk_code)
+{
+    assert(all_registers != NULL);
+    assert(all_segments != NULL);
+
+    /* The destination pair, and the count */
+    uint32_t segment = get_register_value(all_registers, info.rA);
+    uint32_t offset = get_register_value(all_registers, EXT_PAIR(info.rA));
+    uint32_t count = get_register_value(all_registers, info.rC);
+
+    if (bulk_code == BCOPY && info.value == BULK_WRITE) {
+        output_words(all_segments, segment, offset, count);
+    }
+    else if (bulk_code == BCOPY && info.value == BULK_READ) {
+        set_register_value(all_registers, info.rB, 
+                           input_words(all_segments, segment, offset, 
+                                       count));
+    }
+    else if (bulk_code == BCOPY && info.value != BULK_COPY) {
+        exit(EXIT_FAILURE);
+    }
+    else if (bulk_code == BCOPY) {
+        copy_words(all_segments, segment, offset, 
+                   get_register_value(all_registers, info.rB), 
+                   get_register_value(all_registers, EXT_PAIR(info.rB)), 
+                   count);
+    }
+    else {
+        fill_words(all_segments, segment, offset, count, 
+                   get_register_value(all_registers, info.rB));
+    }
+}
+
+/*
+* output_words
+* Purpose: To write a block of a segment to stdout, one character a word
+* Parameters: Memory all_segments - the memory manager
+*             uint32_t segment, first, count - the block
+* Returns: nothing
+* Notes: the words are narrowed into a byte buffer and put out BULK_CHUNK 
+*        characters at a time through the output buffer, which keeps them 
+*        in order with those of output.
+*/
+void output_words(Memory all_segments, uint32_t segment, uint32_t first, 
+                  uint32_t count)
+{
+    assert(all_segments != NULL);
+
+    const uint32_t *words = read_range(all_segments, segment, first, count);
+    unsigned char buffer[BULK_CHUNK];
+
+    while (count > 0) {
+        uint32_t n = count < BULK_CHUNK ? count : BULK_CHUNK;
+
+        for (uint32_t k = 0; k < n; k++) {
+            assert(words[k] <= MAX);
+            buffer[k] = (unsigned char)words[k];
+        }
+        output_bytes(buffer, n);
+        words += n;
+        count -= n;
+    }
+}
+
+/*
+* input_words
+* Purpose: To read characters from stdin into a block of a segment, one 
+*          a word
+* Parameters: Memory all_segments - the memory manager
+*             uint32_t segment, first, count - the block
+* Returns: the number of characters read
+* Notes: each chunk of up to BULK_CHUNK characters waits until it has them 
+*        all or input ends, so a short count means end of input. The block 
+*        is checked before anything is read.
+*/
+uint32_t input_words(Memory all_segments, uint32_t segment, uint32_t first, 
+                     uint32_t count)
+{
+    assert(all_segments != NULL);
+
+    unsigned char buffer[BULK_CHUNK];
+    uint32_t words[BULK_CHUNK];
+    uint32_t total = 0;
+
+    read_range(all_segments, segment, first, count);
+    while (total < count) {
+        uint32_t want = count - total < BULK_CHUNK ? count - total 
+                                                   : BULK_CHUNK;
+        uint32_t n = (uint32_t)input_bytes(buffer, want);
+
+        for (uint32_t k = 0; k < n; k++) {
+            words[k] = buffer[k];
+        }
+        store_words(all_segments, segment, first + total, n, words);
+        total += n;
+        if (n < want) {
+            break;
+        }
+    }
+    return total;
+}
@@ -22,16 +22,117 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <stdint.h>
+#include <stdbool.h>
 #include "register_manager.h"
 #include "memory_manager.h"
 
 #ifndef INSTRUCTION_RETRIEVAL_H
 #define INSTRUCTION_RETRIEVAL_H
 
+/* The fourteen UM instructions, numbered by their opcodes, and the two 
+   extension instructions that only run under --ext */
+typedef enum Um_opcode {
+        CMOV = 0, SLOAD, SSTORE, ADD, MUL, DIV,
+        NAND, HALT, ACTIVATE, INACTIVATE, OUT, IN, LOADP, LV,
+        BCOPY, FILL
+} Um_opcode;
+
+/*
+* The extension instructions name register pairs: register r holds a 
+* segment and register EXT_PAIR(r), the next one round from 7 to 0, holds 
+* a word offset into it. BCOPY also takes a function, the Bulk_function 
+* in bits 9-12 of its word.
+*   BCOPY A B C (copy):   copy $r[C] words from m[$r[B]][$r[B+1]] on to 
+*                         m[$r[A]][$r[A+1]] on, as memmove would
+*   BCOPY A B C (write):  output the $r[C] words from m[$r[A]][$r[A+1]] 
+*                         on, each of which must be at most 255
+*   BCOPY A B C (read):   input up to $r[C] characters into the words from 
+*                         m[$r[A]][$r[A+1]] on; $r[B] gets how many were 
+*                         read, fewer than $r[C] only at end of input
+*   FILL A B C:           store $r[B] into $r[C] words from 
+*                         m[$r[A]][$r[A+1]] on
+* All fail like a load or store if a segment is unmapped or a range runs 
+* past its end, and BCOPY fails for any other function.
+*/
+#define EXT_PAIR(r) (((r) + 1) % NUM_REGISTERS)
+
+/* The functions of BCOPY */
+typedef enum Bulk_function {
+        BULK_COPY = 0, BULK_WRITE, BULK_READ
+} Bulk_function;
+
+/*
+* struct Um_budget
+* Purpose: Lets the caller of an execution engine run it in stages
+* Members: uint64_t executed - the number of instructions run so far; the
+*                   engine adds every instruction it runs, exactly
+*          uint64_t limit - once executed has reached limit, the engine
+*                   pauses after the next load program it runs
+* Notes: pausing only after load program lets the fast engines count a
+*        whole block at a time. A limit of UINT64_MAX never pauses. limit
+*        is volatile because a signal handler may lower it to 0 while an
+*        engine runs, so engines read it afresh at every load program.
+*/
+typedef struct Um_budget {
+        uint64_t executed;
+        volatile uint64_t limit;
+} Um_budget;
+
+/*Returned by an engine that paused for its budget, with the program
+  counter left at the next instruction*/
+#define UM_PAUSED 2
+
+/*
+* struct Info
+* Purpose: An instruction word unpacked into its fields, so that it can be 
+*          decoded once and executed many times
+* Members: uint8_t op - the opcode, the top 4 bits of the word
+*          uint8_t rA, rB, rC - the register indexes. For load value rA is 
+*                  the register in bits 25-27 and rB, rC are 0.
+*          uint32_t value - the 25 bit immediate of load value, the 
+*                   Bulk_function of BCOPY, 0 otherwise
+* Notes: kept to 8 bytes so a decoded program packs 8 instructions per 
+*        cache line
+*/
+struct Info
+{
+    uint8_t op;
+    uint8_t rA;
+    uint8_t rB;
+    uint8_t rC;
+    uint32_t value;
+};
+
 /* A struct pointer to the interpreted uint32_t word instruction*/
 typedef struct Info *Info;
 
 
+/*
+* decode_instruction
+* Purpose: To unpack an instruction word into caller-owned storage
+* Input: the uint32_t word instruction and the struct Info to fill in
+* Returns: nothing
+* Expectation: info is non-NULL. Any word decodes; an invalid opcode only 
+*              fails when it is executed.
+*/
+void decode_instruction(uint32_t instruction, struct Info *info);
+
+
+/*
+* execute_instruction
+* Purpose: To execute one decoded instruction without taking ownership of 
+*          it, so that a decoded program can be run repeatedly
+* Input: the decoded instruction, the Memory and Registers of the machine, 
+*        and a pointer to the program counter (already advanced past this 
+*        instruction)
+* Returns: true while the program should keep running, false once it has 
+*          halted
+* Expectation: None-void parameters
+*/
+bool execute_instruction(const struct Info *info, Memory all_segments, 
+                         Registers all_registers, uint32_t *counter);
+
+
 /*
 * get_info
 * Purpose: To initialize an Info struct based on the unpacking of 
@@ -55,10 +156,72 @@ Info get_Info(uint32_t instruction);
 *          element storing all the segements, a Reister element storing
 *          all the registers, a uint32_t* for program counter, and a file
 *          pointer for input.
-* Returns: void
+* Returns: true while the program should keep running, false once it has 
+*          halted
 * Expectation: None-void parameters
 */
-void instruction_executer(Info info, Memory all_segments, 
+bool instruction_executer(Info info, Memory all_segments, 
                           Registers all_registers, uint32_t *counter);
 
+
+/*
+* opcode_name
+* Purpose: To name an opcode in reports and profiles
+* Input: an opcode, 0-15
+* Returns: its Um_opcode name, such as "LOADP", or "invalid" for 14 and 15 
+*          unless the extensions are on
+* Expectation: none
+*/
+const char *opcode_name(uint32_t op);
+
+
+/*
+* use_extensions
+* Purpose: To turn the extension instructions BCOPY and FILL on or off 
+*          (--ext)
+* Input: true to run opcodes 14 and 15 as BCOPY and FILL, false to fail on 
+*        them as the UM specification requires
+* Returns: nothing
+* Expectation: set before the program starts; off by default
+*/
+void use_extensions(bool enable);
+
+
+/*
+* opcode_valid
+* Purpose: To tell whether an opcode is an instruction the machine runs
+* Input: an opcode, 0-15
+* Returns: true for 0-13, and for 14 and 15 when the extensions are on
+* Expectation: none
+*/
+bool opcode_valid(uint32_t op);
+
+
+/*
+* output_words
+* Purpose: To output a block of words as characters, as BCOPY's write 
+*          function does
+* Input: the Memory of the machine, a segment, the block's first word and 
+*        its number of words
+* Returns: nothing
+* Expectation: the segment is mapped, the block in bounds and every word 
+*              at most 255
+*/
+void output_words(Memory all_segments, uint32_t segment, uint32_t first, 
+                  uint32_t count);
+
+
+/*
+* input_words
+* Purpose: To input characters into a block of words, as BCOPY's read 
+*          function does
+* Input: the Memory of the machine, a segment, the block's first word and 
+*        its number of words
+* Returns: the number of characters read, less than count only at end of 
+*          input; the words past them are left as they were
+* Expectation: the segment is mapped and the block in bounds
+*/
+uint32_t input_words(Memory all_segments, uint32_t segment, uint32_t first, 
+                     uint32_t count);
+
 #endif
\ No newline at end of file
@@ -0,0 +1,1211 @@
+/**************************************************************
+ *                     jit.c
+ *
+ *     Assignment: Homework 6 - Universal Machine Program
+ *     Authors: Katie Yang (zyang11) and Pamela Melgar (pmelga01)
+ *     Date: November 24, 2021
+ *
+ *     Implementation for jit.h
+ *
+ *     Purpose: Translates basic blocks of segment 0 into x86-64 code the
+ *              first time they are reached, and runs them. A block runs
+ *              from its first instruction up to and including the next
+ *              load program or halt (or MAX_BLOCK instructions). While
+ *              translated code runs, UM register n lives in host
+ *              register r8 + n; it is written back to the Jit whenever C
+ *              code is called. Blocks find each other through an entry
+ *              table indexed by program counter, so throwing a block away
+ *              is a single store.
+ *
+ *              Map, unmap, output, input, load program of a non-zero
+ *              segment and stores that need copy-on-write or touch
+ *              segment 0 call back into C, which goes through
+ *              memory_manager.c as the interpreter does. A load or
+ *              division that would fail "bails out": the block returns
+ *              and execute_instruction runs that instruction, so the
+ *              interpreter reports the failure exactly as it always has.
+ *              A block starting at a loop head that idiom.c recognizes
+ *              first calls idiom_run, which runs the whole loop at once
+ *              when it can.
+ *
+ *     Success Output:
+ *              exit_sucess
+ *
+ *     Failure output:
+ *              exit_faliure
+ *
+ *     Note:
+ *              Register usage inside translated code: rbx points at the
+ *              Jit, rbp at the memory manager's Memory_core, r8-r15 hold
+ *              the UM registers, rax, rcx, rdx, rsi and rdi are scratch.
+ *
+ **************************************************************/
+
+#define _GNU_SOURCE /*memfd_create*/
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+#include "jit.h"
+#include "instruction_retrieval.h"
+#include "idiom.h"
+#include "output_buffer.h"
+#include "input_buffer.h"
+#include "assert.h"
+
+#ifndef __x86_64__
+#error "jit.c emits x86-64 code; build another ENGINE on this host"
+#endif
+
+/*Executable memory for translated blocks; when full, all are discarded*/
+#define CODE_BYTES ((size_t)16 << 20)
+/*Longest run of instructions translated as one block*/
+#define MAX_BLOCK 128
+/*Upper bound on the code for one instruction, with its bail-out stub*/
+#define MAX_INSTRUCTION_BYTES 320
+/*Size of a bail-out stub: add executed, n; mov eax, pc; jmp exit_bail*/
+#define STUB_BYTES 18
+/*Upper bound on the call to helper_idiom at a loop head*/
+#define IDIOM_CALL_BYTES 128
+#define MAX_BLOCK_BYTES (MAX_BLOCK * MAX_INSTRUCTION_BYTES + \
+                         IDIOM_CALL_BYTES + 64)
+/*Most bail-out checks a single instruction emits*/
+#define MAX_BAILS 4
+/*log2(sizeof(struct Descriptor)), to index the segment table*/
+#define DESCRIPTOR_SHIFT 6
+
+/*x86-64 register numbers*/
+enum Host_register {
+    RAX = 0, RCX, RDX, RBX, RSP, RBP, RSI, RDI,
+    R8, R9, R10, R11, R12, R13, R14, R15
+};
+
+/*the host register holding UM register n*/
+#define HOST(n) (R8 + (n))
+
+/*x86 condition codes, for jcc and cmovcc*/
+enum Condition {
+    CC_B = 0x2, CC_AE = 0x3, CC_E = 0x4, CC_NE = 0x5, CC_A = 0x7
+};
+
+/*why translated code returned to run_jit*/
+enum Jit_exit {
+    JIT_GOTO = 0, /*reached a pc with no block: translate it*/
+    JIT_BAIL,     /*the instruction at pc must be interpreted*/
+    JIT_HALT,     /*halted, pc is one past the halt*/
+    JIT_PAUSE     /*jumped to pc with the budget used up*/
+};
+
+/*
+* struct Bail
+* Purpose: A conditional jump still waiting for its bail-out stub
+* Members: uint8_t *at - the jump's 32-bit displacement
+*          uint32_t pc - the instruction the stub hands to the interpreter
+*/
+struct Bail
+{
+    uint8_t *at;
+    uint32_t pc;
+};
+
+/*
+* struct Jit
+* Purpose: Everything translated code and its helpers need
+* Members: uint32_t reg[] - the UM registers while C code runs
+*          uint32_t pc - the program counter when a block returns
+*          uint32_t length - the length of segment 0
+*          uint8_t **entry - entry[pc] is the block starting at pc, or NULL
+*          Memory memory - the memory manager
+*          uint8_t *covered - covered[i] is 1 if word i of segment 0 may 
+*                   be part of a live block, so a store there must 
+*                   invalidate it
+*          uint64_t executed - instructions run so far
+*          Um_budget *budget - the budget of the current run; a jump 
+*                   pauses once executed reaches its limit
+*          (the members above are read by translated code at fixed
+*          offsets; the rest are only used from C)
+*          uint32_t *block_end - block_end[pc] is the last instruction of
+*                   the block at entry[pc]
+*          uint8_t *buffer, *next, *limit - the executable memory, the
+*                   first free byte and the end
+*          uint8_t *shadow - a writable mapping of the same memory, where
+*                   the emitter writes; buffer itself if the memory could
+*                   not be mapped twice, and then only the pages being
+*                   translated into are writable, and not executable
+*                   while they are
+*          uint8_t *code_start - where blocks start, after the stubs
+*          uint8_t *enter, *jump, *chain, *exit_goto, *exit_bail, 
+*                   *exit_halt, *exit_pause - the shared stubs (see 
+*                   emit_stubs)
+*          uint32_t block_start - the first instruction of the block being
+*                   translated
+*          struct Bail bails[], uint32_t num_bails - the bail-out jumps
+*                   of the block being translated
+* Notes: buffer is NULL if no executable memory could be mapped
+*/
+struct Jit
+{
+    uint32_t reg[NUM_REGISTERS];
+    uint32_t pc;
+    uint32_t length;
+    uint8_t **entry;
+    Memory memory;
+    uint8_t *covered;
+    uint64_t executed;
+    Um_budget *budget;
+
+    uint32_t *block_end;
+    uint8_t *buffer;
+    uint8_t *next;
+    uint8_t *limit;
+    uint8_t *shadow;
+    uint8_t *code_start;
+    uint8_t *enter;
+    uint8_t *jump;
+    uint8_t *chain;
+    uint8_t *exit_goto;
+    uint8_t *exit_bail;
+    uint8_t *exit_halt;
+    uint8_t *exit_pause;
+    uint32_t block_start;
+    struct Bail bails[MAX_BLOCK * MAX_BAILS];
+    uint32_t num_bails;
+};
+
+/*the stub run_jit calls: saves host state, then jumps to block*/
+typedef int Enter(struct Jit *jit, const uint8_t *block);
+
+/*offset of UM register n in the Jit*/
+#define REG_OFFSET(n) \
+        ((int32_t)(offsetof(struct Jit, reg) + (n) * sizeof(uint32_t)))
+
+
+/*
+* The emitter: each function appends one x86-64 instruction at jit->next.
+* Opcodes above 0xFF are two-byte opcodes starting with 0x0F. Addresses
+* are those of the executable buffer; the bytes go to the same place in
+* the writable shadow.
+*/
+
+/*where the byte of the buffer at "at" is written*/
+static uint8_t *writable(struct Jit *jit, uint8_t *at)
+{
+    return jit->shadow + (at - jit->buffer);
+}
+
+static void emit_byte(struct Jit *jit, uint8_t byte)
+{
+    *writable(jit, jit->next) = byte;
+    jit->next++;
+}
+
+static void emit_u32(struct Jit *jit, uint32_t word)
+{
+    memcpy(writable(jit, jit->next), &word, sizeof(word));
+    jit->next += sizeof(word);
+}
+
+static void emit_u64(struct Jit *jit, uint64_t word)
+{
+    memcpy(writable(jit, jit->next), &word, sizeof(word));
+    jit->next += sizeof(word);
+}
+
+/*
+* emit_prefix
+* Purpose: To emit the REX prefix, if one is needed, and the opcode
+* Parameters: struct Jit *jit - where to emit
+*             bool wide - true for a 64-bit operation
+*             unsigned op - the opcode
+*             unsigned reg, index, base - the registers in the ModRM reg,
+*                      SIB index and ModRM rm/SIB base fields
+* Returns: nothing
+*/
+static void emit_prefix(struct Jit *jit, bool wide, unsigned op,
+                        unsigned reg, unsigned index, unsigned base)
+{
+    uint8_t rex = 0x40 | (wide << 3) | ((reg >> 3) << 2) |
+                  ((index >> 3) << 1) | (base >> 3);
+
+    if (rex != 0x40) {
+        emit_byte(jit, rex);
+    }
+    if (op > 0xFF) {
+        emit_byte(jit, op >> 8);
+    }
+    emit_byte(jit, op & 0xFF);
+}
+
+/*op reg, rm between two registers (reg may be an opcode extension)*/
+static void emit_rr(struct Jit *jit, bool wide, unsigned op, unsigned reg,
+                    unsigned rm)
+{
+    emit_prefix(jit, wide, op, reg, 0, rm);
+    emit_byte(jit, 0xC0 | ((reg & 7) << 3) | (rm & 7));
+}
+
+/*op reg, [base + disp]*/
+static void emit_rm(struct Jit *jit, bool wide, unsigned op, unsigned reg,
+                    unsigned base, int32_t disp)
+{
+    unsigned mod = 2;
+
+    if (disp == 0 && (base & 7) != RBP) {
+        mod = 0;
+    }
+    else if (disp >= -128 && disp <= 127) {
+        mod = 1;
+    }
+
+    emit_prefix(jit, wide, op, reg, 0, base);
+    emit_byte(jit, (mod << 6) | ((reg & 7) << 3) | (base & 7));
+    if ((base & 7) == RSP) {
+        emit_byte(jit, 0x24);
+    }
+    if (mod == 1) {
+        emit_byte(jit, (uint8_t)disp);
+    }
+    else if (mod == 2) {
+        emit_u32(jit, (uint32_t)disp);
+    }
+}
+
+/*op reg, [base + index << scale]*/
+static void emit_rsib(struct Jit *jit, bool wide, unsigned op, unsigned reg,
+                      unsigned base, unsigned index, unsigned scale)
+{
+    assert((base & 7) != RBP && index != RSP && scale <= 3);
+
+    emit_prefix(jit, wide, op, reg, index, base);
+    emit_byte(jit, ((reg & 7) << 3) | RSP);
+    emit_byte(jit, (scale << 6) | ((index & 7) << 3) | (base & 7));
+}
+
+/*mov r32, imm32*/
+static void emit_mov_imm(struct Jit *jit, unsigned reg, uint32_t value)
+{
+    emit_prefix(jit, false, 0xB8 + (reg & 7), 0, 0, reg);
+    emit_u32(jit, value);
+}
+
+/*push r64 / pop r64*/
+static void emit_push(struct Jit *jit, unsigned reg)
+{
+    emit_prefix(jit, false, 0x50 + (reg & 7), 0, 0, reg);
+}
+
+static void emit_pop(struct Jit *jit, unsigned reg)
+{
+    emit_prefix(jit, false, 0x58 + (reg & 7), 0, 0, reg);
+}
+
+/*
+* patch
+* Purpose: To point a jump emitted earlier at its target
+* Parameters: struct Jit *jit - the JIT
+*             uint8_t *at - the jump's 32-bit displacement
+*             const uint8_t *target - where it should go
+* Returns: nothing
+*/
+static void patch(struct Jit *jit, uint8_t *at, const uint8_t *target)
+{
+    int32_t displacement = (int32_t)(target - (at + sizeof(int32_t)));
+
+    memcpy(writable(jit, at), &displacement, sizeof(displacement));
+}
+
+/*jcc rel32 with the target left for patch; returns the displacement*/
+static uint8_t *emit_jcc(struct Jit *jit, enum Condition cc)
+{
+    emit_byte(jit, 0x0F);
+    emit_byte(jit, 0x80 | cc);
+    emit_u32(jit, 0);
+    return jit->next - sizeof(int32_t);
+}
+
+/*jmp rel32 with the target left for patch; returns the displacement*/
+static uint8_t *emit_jmp(struct Jit *jit)
+{
+    emit_byte(jit, 0xE9);
+    emit_u32(jit, 0);
+    return jit->next - sizeof(int32_t);
+}
+
+static void emit_jcc_to(struct Jit *jit, enum Condition cc,
+                        const uint8_t *target)
+{
+    patch(jit, emit_jcc(jit, cc), target);
+}
+
+static void emit_jmp_to(struct Jit *jit, const uint8_t *target)
+{
+    patch(jit, emit_jmp(jit), target);
+}
+
+/*add the instructions a block ran to jit->executed before leaving it*/
+static void emit_count(struct Jit *jit, uint32_t instructions)
+{
+    emit_rm(jit, true, 0x81, 0, RBX, offsetof(struct Jit, executed));
+    emit_u32(jit, instructions);
+}
+
+/*copy the UM registers from the host registers into jit->reg*/
+static void emit_spill(struct Jit *jit)
+{
+    for (unsigned n = 0; n < NUM_REGISTERS; n++) {
+        emit_rm(jit, false, 0x89, HOST(n), RBX, REG_OFFSET(n));
+    }
+}
+
+/*and back*/
+static void emit_reload(struct Jit *jit)
+{
+    for (unsigned n = 0; n < NUM_REGISTERS; n++) {
+        emit_rm(jit, false, 0x8B, HOST(n), RBX, REG_OFFSET(n));
+    }
+}
+
+/*
+* emit_call
+* Purpose: To call a helper as helper(jit, a, b, c), where a, b and c are
+*          UM register numbers and the helper works on jit->reg
+* Parameters: struct Jit *jit - where to emit
+*             uint64_t helper - the helper's address
+*             unsigned a, b, c - its register number arguments (helpers
+*                      taking fewer simply ignore the rest)
+* Returns: nothing; in the translated code, the helper's result is in eax
+* Notes: the stack is 16-byte aligned inside every block (see emit_stubs)
+*/
+static void emit_call(struct Jit *jit, uint64_t helper, unsigned a,
+                      unsigned b, unsigned c)
+{
+    emit_spill(jit);
+    emit_rr(jit, true, 0x89, RBX, RDI);
+    emit_mov_imm(jit, RSI, a);
+    emit_mov_imm(jit, RDX, b);
+    emit_mov_imm(jit, RCX, c);
+    emit_prefix(jit, true, 0xB8, 0, 0, RAX);
+    emit_u64(jit, helper);
+    emit_rr(jit, false, 0xFF, 2, RAX);
+    emit_reload(jit);
+}
+
+
+/*
+* Helpers called from translated code. The UM registers are in jit->reg
+* while they run, and go back into host registers after they return.
+*/
+
+/*
+* invalidate
+* Purpose: To throw away every block containing instruction word_index
+*          after that instruction has been stored into
+* Parameters: struct Jit *jit - the JIT
+*             uint32_t word_index - the instruction that changed
+* Returns: nothing
+* Notes: no block is longer than MAX_BLOCK, so only blocks starting that
+*        close before the instruction need checking. Their code stays in
+*        the buffer until it is next flushed.
+*/
+static void invalidate(struct Jit *jit, uint32_t word_index)
+{
+    uint32_t first = word_index >= MAX_BLOCK ?
+                     word_index - (MAX_BLOCK - 1) : 0;
+
+    for (uint32_t start = first; start <= word_index; start++) {
+        if (jit->entry[start] != NULL &&
+            jit->block_end[start] >= word_index) {
+            jit->entry[start] = NULL;
+        }
+    }
+    jit->covered[word_index] = 0;
+}
+
+/*
+* flush
+* Purpose: To throw away every block and size the tables for the current
+*          segment 0
+* Parameters: struct Jit *jit - the JIT
+* Returns: nothing
+* Notes: only the stubs survive. Safe to call from a helper: the code
+*        that called it is not overwritten until the next translation.
+*/
+static void flush(struct Jit *jit)
+{
+    uint32_t length = segmentlength(jit->memory, 0);
+
+    if (length != jit->length) {
+        free(jit->entry);
+        free(jit->block_end);
+        free(jit->covered);
+        jit->entry = malloc((length + 1) * sizeof(jit->entry[0]));
+        jit->block_end = malloc((length + 1) * sizeof(jit->block_end[0]));
+        jit->covered = malloc(length + 1);
+        assert(jit->entry != NULL && jit->block_end != NULL &&
+               jit->covered != NULL);
+        jit->length = length;
+    }
+    memset(jit->entry, 0, length * sizeof(jit->entry[0]));
+    memset(jit->covered, 0, length);
+    jit->next = jit->code_start;
+}
+
+/*
+* helper_store
+* Purpose: The segmented store translated code cannot finish inline: one
+*          into a translated word of segment 0, into a block still shared 
+*          after load program, or one that is about to fail
+* Parameters: struct Jit *jit - the JIT
+*             uint32_t a, b, c - the instruction's register numbers
+* Returns: 1 if a block was invalidated, so the caller must return to
+*          run_jit in case it was its own; otherwise 0
+*/
+static uint32_t helper_store(struct Jit *jit, uint32_t a, uint32_t b,
+                             uint32_t c)
+{
+    uint32_t segment = jit->reg[a];
+    uint32_t word_index = jit->reg[b];
+    uint32_t word = jit->reg[c];
+
+    if (segment != 0) {
+        set_word(jit->memory, segment, word_index, word);
+        return 0;
+    }
+
+    uint32_t old = get_word(jit->memory, 0, word_index);
+
+    set_word(jit->memory, 0, word_index, word);
+    if (old == word || !jit->covered[word_index]) {
+        return 0;
+    }
+    invalidate(jit, word_index);
+    return 1;
+}
+
+/*
+* helper_loadp
+* Purpose: Load program of a non-zero segment: replaces segment 0 and
+*          discards every block
+* Parameters: struct Jit *jit - the JIT
+*             uint32_t b, c - the instruction's register numbers
+* Returns: the new program counter
+*/
+static uint32_t helper_loadp(struct Jit *jit, uint32_t b, uint32_t c)
+{
+    duplicate_segment(jit->memory, jit->reg[b]);
+    flush(jit);
+    return jit->reg[c];
+}
+
+/*
+* decode_loop
+* Purpose: To decode the words that may make up a loop starting at head
+* Parameters: struct Jit *jit - the JIT
+*             uint32_t head - the candidate loop head, within segment 0
+*             struct Info loop[] - room for IDIOM_MAX_LENGTH instructions
+* Returns: the idiom starting at head, or IDIOM_NONE
+*/
+static Idiom decode_loop(struct Jit *jit, uint32_t head, struct Info loop[])
+{
+    const uint32_t *words = segment_words(jit->memory, 0);
+    uint32_t room = jit->length - head;
+
+    if (room > IDIOM_MAX_LENGTH) {
+        room = IDIOM_MAX_LENGTH;
+    }
+    for (uint32_t i = 0; i < room; i++) {
+        decode_instruction(words[head + i], &loop[i]);
+    }
+    return idiom_in(loop, room, head);
+}
+
+/*
+* helper_idiom
+* Purpose: To run a whole recognized loop natively from its head
+* Parameters: struct Jit *jit - the JIT
+*             uint32_t idiom - the Idiom emit_block found at head
+*             uint32_t head - the loop head
+* Returns: one more than the program counter after the loop, or 0 if 
+*          idiom_run refused it and the translated loop must run instead
+* Notes: a store into the loop's words invalidates the block that calls 
+*        this, so the words still make up the same loop
+*/
+static uint32_t helper_idiom(struct Jit *jit, uint32_t idiom, uint32_t head)
+{
+    struct Info loop[IDIOM_MAX_LENGTH];
+    uint32_t pc;
+
+    decode_loop(jit, head, loop);
+    if (!idiom_run((Idiom)idiom, loop, jit->memory, jit->reg, &pc,
+                   &jit->executed)) {
+        return 0;
+    }
+    return pc + 1;
+}
+
+static uint32_t helper_map(struct Jit *jit, uint32_t b, uint32_t c)
+{
+    jit->reg[b] = map_segment(jit->memory, jit->reg[c]);
+    return 0;
+}
+
+static uint32_t helper_unmap(struct Jit *jit, uint32_t c)
+{
+    unmap_segment(jit->memory, jit->reg[c]);
+    return 0;
+}
+
+static uint32_t helper_out(struct Jit *jit, uint32_t c)
+{
+    uint32_t val = jit->reg[c];
+
+    assert(val <= 255);
+    output_char(val);
+    return 0;
+}
+
+static uint32_t helper_in(struct Jit *jit, uint32_t c)
+{
+    /*EOF reads back as all ones*/
+    jit->reg[c] = input_char();
+    return 0;
+}
+
+/*the address of a helper, as emit_call takes it*/
+#define HELPER(name) ((uint64_t)(uintptr_t)(name))
+
+
+/*
+* emit_stubs
+* Purpose: To emit the code shared by every block at the start of the
+*          buffer
+* Parameters: struct Jit *jit - the JIT, with an empty buffer
+* Returns: nothing
+* Notes: enter(jit, block) saves the callee-saved registers, loads the UM
+*        registers and jumps to block; with the return address and six
+*        pushes, one more 8-byte adjustment leaves the stack 16-byte
+*        aligned for helper calls. jump, where load program goes, leaves 
+*        through exit_pause if the budget is used up and otherwise falls 
+*        into chain, which jumps to the block for the pc in eax, or 
+*        leaves through exit_goto if there is none. The exits
+*        store eax as jit->pc, save the UM registers and return their
+*        Jit_exit to enter's caller.
+*/
+static void emit_stubs(struct Jit *jit)
+{
+    static const unsigned saved[] = { RBX, RBP, R12, R13, R14, R15 };
+    const unsigned num_saved = sizeof(saved) / sizeof(saved[0]);
+    uint8_t *leave;
+
+    jit->enter = jit->next;
+    for (unsigned i = 0; i < num_saved; i++) {
+        emit_push(jit, saved[i]);
+    }
+    emit_rr(jit, true, 0x83, 5, RSP);                 /*sub rsp, 8*/
+    emit_byte(jit, 8);
+    emit_rr(jit, true, 0x89, RDI, RBX);
+    emit_rm(jit, true, 0x8B, RBP, RBX, offsetof(struct Jit, memory));
+    emit_reload(jit);
+    emit_rr(jit, false, 0xFF, 4, RSI);                /*jmp rsi*/
+
+    leave = jit->next;
+    emit_spill(jit);
+    emit_rr(jit, true, 0x83, 0, RSP);                 /*add rsp, 8*/
+    emit_byte(jit, 8);
+    for (unsigned i = num_saved; i > 0; i--) {
+        emit_pop(jit, saved[i - 1]);
+    }
+    emit_byte(jit, 0xC3);                             /*ret*/
+
+    uint8_t **exits[] = { &jit->exit_goto, &jit->exit_bail,
+                          &jit->exit_halt, &jit->exit_pause };
+    for (unsigned why = JIT_GOTO; why <= JIT_PAUSE; why++) {
+        *exits[why] = jit->next;
+        emit_rm(jit, false, 0x89, RAX, RBX, offsetof(struct Jit, pc));
+        emit_mov_imm(jit, RAX, why);
+        emit_jmp_to(jit, leave);
+    }
+
+    jit->jump = jit->next;
+    emit_rm(jit, true, 0x8B, RDX, RBX, offsetof(struct Jit, budget));
+    emit_rm(jit, true, 0x8B, RDX, RDX, offsetof(Um_budget, limit));
+    emit_rm(jit, true, 0x39, RDX, RBX, offsetof(struct Jit, executed));
+    emit_jcc_to(jit, CC_AE, jit->exit_pause);
+
+    jit->chain = jit->next;
+    emit_rm(jit, false, 0x3B, RAX, RBX, offsetof(struct Jit, length));
+    emit_jcc_to(jit, CC_AE, jit->exit_goto);
+    emit_rm(jit, true, 0x8B, RDX, RBX, offsetof(struct Jit, entry));
+    emit_rsib(jit, true, 0x8B, RDX, RDX, RAX, 3);
+    emit_rr(jit, true, 0x85, RDX, RDX);
+    emit_jcc_to(jit, CC_E, jit->exit_goto);
+    emit_rr(jit, false, 0xFF, 4, RDX);                /*jmp rdx*/
+
+    jit->code_start = jit->next;
+}
+
+/*
+* add_bail
+* Purpose: To record a conditional jump that hands the instruction at pc 
+*          to the interpreter
+* Parameters: struct Jit *jit - the JIT
+*             uint8_t *at - the jump's displacement, from emit_jcc
+*             uint32_t pc - the instruction being translated
+* Returns: nothing; the jump is pointed at a stub when the block ends
+*/
+static void add_bail(struct Jit *jit, uint8_t *at, uint32_t pc)
+{
+    assert(jit->num_bails < MAX_BLOCK * MAX_BAILS);
+
+    jit->bails[jit->num_bails].at = at;
+    jit->bails[jit->num_bails].pc = pc;
+    jit->num_bails++;
+}
+
+/*
+* emit_lookup
+* Purpose: To find word index of segment id: leaves the segment's
+*          descriptor in rax and its words in rdx
+* Parameters: struct Jit *jit - the JIT
+*             unsigned id, index - host registers holding the segment ID
+*                      and word index
+*             uint8_t *fails[3] - receives the jumps taken if the ID is
+*                      out of range, the segment unmapped, or the index
+*                      out of bounds
+* Returns: nothing
+* Notes: the inline form of memory_lookup plus get_word's bounds check,
+*        without the lookaside
+*/
+static void emit_lookup(struct Jit *jit, unsigned id, unsigned index,
+                        uint8_t *fails[3])
+{
+    emit_rr(jit, false, 0x89, id, RAX);
+    emit_rm(jit, false, 0x3B, RAX, RBP,
+            offsetof(struct Memory_core, table_length));
+    fails[0] = emit_jcc(jit, CC_AE);
+    emit_rr(jit, true, 0xC1, 4, RAX);                 /*shl rax, 6*/
+    emit_byte(jit, DESCRIPTOR_SHIFT);
+    emit_rm(jit, true, 0x03, RAX, RBP, offsetof(struct Memory_core, table));
+    emit_rm(jit, true, 0x8B, RDX, RAX, offsetof(struct Descriptor, base));
+    emit_rr(jit, true, 0x85, RDX, RDX);
+    fails[1] = emit_jcc(jit, CC_E);
+    emit_rm(jit, false, 0x3B, index, RAX,
+            offsetof(struct Descriptor, length));
+    fails[2] = emit_jcc(jit, CC_AE);
+}
+
+/*
+* emit_store
+* Purpose: To translate a segmented store. Stores into an unshared 
+*          segment are done inline, unless they go to a word of segment 0 
+*          that a block was translated from; the rest go to helper_store.
+* Parameters: struct Jit *jit - the JIT
+*             const struct Info *info - the instruction
+*             uint32_t pc - its position in segment 0
+* Returns: nothing
+* Notes: inline stores into segment 0 bypass set_word, so the memory 
+*        manager's record of stored-into words (kept for predecode) is not 
+*        updated; the JIT does not use it
+*/
+static void emit_store(struct Jit *jit, const struct Info *info,
+                       uint32_t pc)
+{
+    unsigned ra = HOST(info->rA), rb = HOST(info->rB), rc = HOST(info->rC);
+    uint8_t *slow[5];
+    uint8_t *unshared, *fast, *done, *stay;
+    int32_t refs = (int32_t)offsetof(struct Segment, refs) -
+                   (int32_t)offsetof(struct Segment, words);
+
+    emit_lookup(jit, ra, rb, slow);
+    emit_rm(jit, false, 0x83, 7, RAX, offsetof(struct Descriptor, state));
+    emit_byte(jit, SEG_BLOCK);                        /*cmp state, BLOCK*/
+    unshared = emit_jcc(jit, CC_NE);
+    emit_rm(jit, false, 0x83, 7, RDX, refs);          /*cmp refs, 1*/
+    emit_byte(jit, 1);
+    slow[3] = emit_jcc(jit, CC_A);
+    patch(jit, unshared, jit->next);
+    emit_rr(jit, false, 0x85, ra, ra);
+    fast = emit_jcc(jit, CC_NE);
+    emit_rm(jit, true, 0x8B, RSI, RBX, offsetof(struct Jit, covered));
+    emit_rsib(jit, false, 0x80, 7, RSI, rb, 0);       /*cmp covered, 0*/
+    emit_byte(jit, 0);
+    slow[4] = emit_jcc(jit, CC_NE);
+    patch(jit, fast, jit->next);
+    emit_rsib(jit, false, 0x89, rc, RDX, rb, 2);
+    done = emit_jmp(jit);
+
+    for (unsigned i = 0; i < 5; i++) {
+        patch(jit, slow[i], jit->next);
+    }
+    emit_call(jit, HELPER(helper_store), info->rA, info->rB, info->rC);
+    emit_rr(jit, false, 0x85, RAX, RAX);
+    stay = emit_jcc(jit, CC_E);
+    emit_count(jit, pc + 1 - jit->block_start);
+    emit_mov_imm(jit, RAX, pc + 1);
+    emit_jmp_to(jit, jit->exit_goto);
+    patch(jit, stay, jit->next);
+    patch(jit, done, jit->next);
+}
+
+/*
+* emit_instruction
+* Purpose: To translate one instruction
+* Parameters: struct Jit *jit - the JIT
+*             const struct Info *info - the instruction, a valid opcode
+*             uint32_t pc - its position in segment 0
+* Returns: nothing
+* Notes: arithmetic goes through eax so any of rA, rB and rC may be the
+*        same register
+*/
+static void emit_instruction(struct Jit *jit, const struct Info *info,
+                             uint32_t pc)
+{
+    unsigned ra = HOST(info->rA), rb = HOST(info->rB), rc = HOST(info->rC);
+    uint8_t *fails[3];
+
+    switch ((Um_opcode)info->op) {
+    case CMOV:
+        emit_rr(jit, false, 0x85, rc, rc);
+        emit_rr(jit, false, 0x0F40 | CC_NE, ra, rb);
+        break;
+    case SLOAD:
+        emit_lookup(jit, rb, rc, fails);
+        for (unsigned i = 0; i < 3; i++) {
+            add_bail(jit, fails[i], pc);
+        }
+        emit_rsib(jit, false, 0x8B, ra, RDX, rc, 2);
+        break;
+    case SSTORE:
+        emit_store(jit, info, pc);
+        break;
+    case ADD:
+    case MUL:
+    case NAND:
+        emit_rr(jit, false, 0x89, rb, RAX);
+        if (info->op == ADD) {
+            emit_rr(jit, false, 0x03, RAX, rc);
+        }
+        else if (info->op == MUL) {
+            emit_rr(jit, false, 0x0FAF, RAX, rc);
+        }
+        else {
+            emit_rr(jit, false, 0x23, RAX, rc);
+            emit_rr(jit, false, 0xF7, 2, RAX);        /*not eax*/
+        }
+        emit_rr(jit, false, 0x89, RAX, ra);
+        break;
+    case DIV:
+        emit_rr(jit, false, 0x89, rc, RCX);
+        emit_rr(jit, false, 0x85, RCX, RCX);
+        add_bail(jit, emit_jcc(jit, CC_E), pc);
+        emit_rr(jit, false, 0x89, rb, RAX);
+        emit_rr(jit, false, 0x31, RDX, RDX);
+        emit_rr(jit, false, 0xF7, 6, RCX);            /*div ecx*/
+        emit_rr(jit, false, 0x89, RAX, ra);
+        break;
+    case HALT:
+        emit_count(jit, pc + 1 - jit->block_start);
+        emit_mov_imm(jit, RAX, pc + 1);
+        emit_jmp_to(jit, jit->exit_halt);
+        break;
+    case ACTIVATE:
+        emit_call(jit, HELPER(helper_map), info->rB, info->rC, 0);
+        break;
+    case INACTIVATE:
+        emit_call(jit, HELPER(helper_unmap), info->rC, 0, 0);
+        break;
+    case OUT:
+        emit_call(jit, HELPER(helper_out), info->rC, 0, 0);
+        break;
+    case IN:
+        emit_call(jit, HELPER(helper_in), info->rC, 0, 0);
+        break;
+    case LOADP:
+        /*load program of segment 0 is a jump*/
+        emit_count(jit, pc + 1 - jit->block_start);
+        emit_rr(jit, false, 0x89, rc, RAX);
+        emit_rr(jit, false, 0x85, rb, rb);
+        emit_jcc_to(jit, CC_E, jit->jump);
+        emit_call(jit, HELPER(helper_loadp), info->rB, info->rC, 0);
+        emit_jmp_to(jit, jit->jump);
+        break;
+    case LV:
+        emit_mov_imm(jit, ra, info->value);
+        break;
+    case BCOPY:
+    case FILL:
+        /*translate ends a block before these, for interpret to run*/
+        assert(false);
+        break;
+    }
+}
+
+/*
+* protect_block
+* Purpose: To set the protection of the pages a block starting at from 
+*          may be emitted into
+* Parameters: struct Jit *jit - the JIT
+*             uint8_t *from - where the block starts
+*             int prot - the protection, as for mprotect
+* Returns: true if it was set
+* Notes: only needed when the buffer is its own shadow. It is then never 
+*        writable and executable at once: it is executable except while 
+*        translate writes into it.
+*/
+static bool protect_block(struct Jit *jit, uint8_t *from, int prot)
+{
+    if (jit->shadow != jit->buffer) {
+        return true;
+    }
+
+    uintptr_t page = (uintptr_t)sysconf(_SC_PAGESIZE);
+    uintptr_t first = (uintptr_t)from & ~(page - 1);
+    uintptr_t last = (uintptr_t)from + MAX_BLOCK_BYTES;
+
+    if (last > (uintptr_t)jit->limit) {
+        last = (uintptr_t)jit->limit;
+    }
+    last = (last + page - 1) & ~(page - 1);
+    return mprotect((void *)first, last - first, prot) == 0;
+}
+
+/*
+* emit_block
+* Purpose: To emit the block starting at pc, for translate
+* Parameters: struct Jit *jit - the JIT, with room for a whole block
+*             uint32_t pc - the first instruction, within segment 0
+* Returns: the block's code, or NULL if the instruction at pc is invalid
+* Notes: the pages from jit->next on must be writable
+*/
+static uint8_t *emit_block(struct Jit *jit, uint32_t pc)
+{
+    const uint32_t *words = segment_words(jit->memory, 0);
+    uint8_t *start = jit->next;
+    uint32_t end = pc;
+    bool ended = false;
+
+    jit->num_bails = 0;
+    jit->block_start = pc;
+
+    /*a recognized loop is run by idiom_run when it can be, and by the
+      translated loop below when it is refused. Loops are entered by
+      their back edge, which always starts a block at the head.*/
+    struct Info loop[IDIOM_MAX_LENGTH];
+    Idiom idiom = decode_loop(jit, pc, loop);
+    if (idiom != IDIOM_NONE) {
+        emit_call(jit, HELPER(helper_idiom), idiom, pc, 0);
+        emit_rr(jit, false, 0x85, RAX, RAX);
+        uint8_t *refused = emit_jcc(jit, CC_E);
+        emit_rr(jit, false, 0x83, 5, RAX);            /*sub eax, 1*/
+        emit_byte(jit, 1);
+        emit_jmp_to(jit, jit->jump);
+        patch(jit, refused, jit->next);
+        assert(jit->next - start <= IDIOM_CALL_BYTES);
+    }
+
+    while (!ended && end < jit->length && end - pc < MAX_BLOCK) {
+        uint8_t *before = jit->next;
+        struct Info info;
+
+        decode_instruction(words[end], &info);
+        if (info.op > LV) {
+            break;
+        }
+        emit_instruction(jit, &info, end);
+        ended = info.op == LOADP || info.op == HALT;
+        end++;
+        assert(jit->next - before <= MAX_INSTRUCTION_BYTES - STUB_BYTES);
+    }
+    if (end == pc) {
+        return NULL;
+    }
+    if (!ended) {
+        emit_count(jit, end - pc);
+        emit_mov_imm(jit, RAX, end);
+        emit_jmp_to(jit, jit->chain);
+    }
+
+    /*one stub per instruction that can bail out*/
+    uint8_t *stub = NULL;
+    for (uint32_t i = 0; i < jit->num_bails; i++) {
+        if (i == 0 || jit->bails[i].pc != jit->bails[i - 1].pc) {
+            stub = jit->next;
+            emit_count(jit, jit->bails[i].pc - pc);
+            emit_mov_imm(jit, RAX, jit->bails[i].pc);
+            emit_jmp_to(jit, jit->exit_bail);
+        }
+        patch(jit, jit->bails[i].at, stub);
+    }
+
+    jit->entry[pc] = start;
+    jit->block_end[pc] = end - 1;
+    memset(&jit->covered[pc], 1, end - pc);
+    return start;
+}
+
+/*
+* translate
+* Purpose: To translate the block starting at pc
+* Parameters: struct Jit *jit - the JIT
+*             uint32_t pc - the first instruction, within segment 0
+* Returns: the block's code, or NULL if the instruction at pc is invalid
+*          or there is no executable memory
+* Notes: may flush every other block to make room. Only called from
+*        run_jit, never while translated code is running. Without a
+*        shadow, the pages the block may take are writable, and not
+*        executable, only while it is emitted.
+*/
+static uint8_t *translate(struct Jit *jit, uint32_t pc)
+{
+    if (jit->buffer == NULL) {
+        return NULL;
+    }
+    if ((size_t)(jit->limit - jit->next) < MAX_BLOCK_BYTES) {
+        flush(jit);
+    }
+
+    uint8_t *start = jit->next;
+
+    if (!protect_block(jit, start, PROT_READ | PROT_WRITE)) {
+        return NULL;
+    }
+    uint8_t *block = emit_block(jit, pc);
+    bool sealed = protect_block(jit, start, PROT_READ | PROT_EXEC);
+
+    assert(sealed);
+    return block;
+}
+
+/*
+* interpret
+* Purpose: To run the instruction at *pc with execute_instruction, the
+*          reference the translated code falls back on
+* Parameters: struct Jit *jit - the JIT, holding the registers
+*             Registers all_registers - the register manager
+*             uint32_t *pc - the instruction to run; left at the next one
+* Returns: JIT_HALT if the instruction halted the program, JIT_PAUSE if
+*          it was a load program that used up the budget, else JIT_GOTO
+* Notes: keeps the blocks in step with stores and loads it performs. 
+*        The extension instructions always run here.
+*/
+static enum Jit_exit interpret(struct Jit *jit, Registers all_registers,
+                               uint32_t *pc)
+{
+    struct Info instruction;
+
+    decode_instruction(get_word(jit->memory, 0, *pc), &instruction);
+
+    uint32_t value_a = jit->reg[instruction.rA];
+    uint32_t value_b = jit->reg[instruction.rB];
+    uint32_t value_a1 = jit->reg[EXT_PAIR(instruction.rA)];
+    uint32_t value_c = jit->reg[instruction.rC];
+    bool running;
+
+    memcpy(all_registers->registers, jit->reg, sizeof(jit->reg));
+    (*pc)++;
+    running = execute_instruction(&instruction, jit->memory, all_registers,
+                                  pc);
+    memcpy(jit->reg, all_registers->registers, sizeof(jit->reg));
+    jit->executed++;
+
+    /*a store into segment 0 leaves value_b as the word's index*/
+    if (instruction.op == SSTORE && value_a == 0 && jit->covered[value_b]) {
+        invalidate(jit, value_b);
+    }
+    else if (instruction.op == LOADP && value_b != 0) {
+        flush(jit);
+    }
+    else if ((instruction.op == BCOPY || instruction.op == FILL) && 
+             instruction.value != BULK_WRITE && value_a == 0) {
+        /*a bulk store into segment 0: value_a1 and value_c bound its range*/
+        for (uint32_t k = 0; k < value_c; k++) {
+            if (jit->covered[value_a1 + k]) {
+                invalidate(jit, value_a1 + k);
+            }
+        }
+    }
+
+    if (!running) {
+        return JIT_HALT;
+    }
+    if (instruction.op == LOADP && jit->executed >= jit->budget->limit) {
+        return JIT_PAUSE;
+    }
+    return JIT_GOTO;
+}
+
+/*
+* map_buffer
+* Purpose: To map the JIT's code buffer
+* Parameters: struct Jit *jit - the JIT, with no buffer yet
+* Returns: nothing; jit->buffer is NULL if nothing could be mapped
+* Notes: the buffer is one memory file mapped twice, executable for 
+*        running and writable as the shadow, so translating never changes 
+*        a protection. Where that is not possible it is mapped once, 
+*        writable, to be made executable after the stubs are emitted.
+*/
+static void map_buffer(struct Jit *jit)
+{
+    void *run = MAP_FAILED;
+    void *write = MAP_FAILED;
+    int fd = memfd_create("um-jit", MFD_CLOEXEC);
+
+    if (fd >= 0) {
+        if (ftruncate(fd, CODE_BYTES) == 0) {
+            run = mmap(NULL, CODE_BYTES, PROT_READ | PROT_EXEC, MAP_SHARED,
+                       fd, 0);
+            write = mmap(NULL, CODE_BYTES, PROT_READ | PROT_WRITE,
+                         MAP_SHARED, fd, 0);
+        }
+        close(fd);
+    }
+    if (run != MAP_FAILED && write != MAP_FAILED) {
+        jit->buffer = run;
+        jit->shadow = write;
+        return;
+    }
+    if (run != MAP_FAILED) {
+        munmap(run, CODE_BYTES);
+    }
+    if (write != MAP_FAILED) {
+        munmap(write, CODE_BYTES);
+    }
+
+    void *buffer = mmap(NULL, CODE_BYTES, PROT_READ | PROT_WRITE,
+                        MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (buffer != MAP_FAILED) {
+        jit->buffer = buffer;
+        jit->shadow = buffer;
+    }
+}
+
+/*
+* jit_new
+* Purpose: To set up a JIT for a program, with no blocks yet
+* Parameters: Memory all_segments - the memory manager, segment 0 loaded
+* Returns: the new JIT; its buffer is NULL if mapping executable memory
+*          failed
+* Notes: no mapping of the buffer is ever both writable and executable
+*/
+Jit jit_new(Memory all_segments)
+{
+    assert(all_segments != NULL);
+
+    struct Jit *jit = calloc(1, sizeof(*jit));
+    assert(jit != NULL);
+
+    jit->memory = all_segments;
+    jit->length = UINT32_MAX;
+
+    map_buffer(jit);
+    if (jit->buffer != NULL) {
+        jit->next = jit->buffer;
+        jit->limit = jit->buffer + CODE_BYTES;
+        emit_stubs(jit);
+        if (jit->shadow == jit->buffer &&
+            mprotect(jit->buffer, CODE_BYTES, PROT_READ | PROT_EXEC) != 0) {
+            munmap(jit->buffer, CODE_BYTES);
+            jit->buffer = NULL;
+        }
+    }
+    flush(jit);
+    return jit;
+}
+
+/*
+* jit_free
+* Purpose: To release a JIT and its executable memory
+* Parameters: Jit *jit - the JIT, set to NULL
+* Returns: nothing
+*/
+void jit_free(Jit *jit)
+{
+    assert(jit != NULL && *jit != NULL);
+
+    if ((*jit)->buffer != NULL) {
+        if ((*jit)->shadow != (*jit)->buffer) {
+            munmap((*jit)->shadow, CODE_BYTES);
+        }
+        munmap((*jit)->buffer, CODE_BYTES);
+    }
+    free((*jit)->entry);
+    free((*jit)->block_end);
+    free((*jit)->covered);
+    free(*jit);
+    *jit = NULL;
+}
+
+/*
+* run_jit
+* Purpose: To execute the program, translating each block the first time
+*          it is reached and interpreting what the blocks hand back
+* Parameters: Jit jit - the JIT, holding the segment manager and the 
+*                       blocks translated by earlier calls
+*             Registers all_registers - a reference to the register manager
+*                       used throughout the program.
+*             uint32_t *counter - the program counter to start from; on
+*                       return it is one past the last instruction run
+*             Um_budget *budget - the instructions run so far and when 
+*                       to pause
+* Returns: EXIT_SUCCESS on halt, EXIT_FAILURE on running off the end, 
+*          UM_PAUSED when the budget ran out
+* Notes: blocks are translated straight from the words of segment 0, so 
+*        no decoded Program is needed. The registers are written back to 
+*        all_registers whenever an instruction is interpreted and on 
+*        return
+*/
+int run_jit(Jit jit, Registers all_registers, uint32_t *counter,
+            Um_budget *budget)
+{
+    assert(jit != NULL);
+    assert(all_registers != NULL);
+    assert(counter != NULL);
+    assert(budget != NULL);
+
+    uint32_t pc = *counter;
+    int status = EXIT_FAILURE;
+    Enter *enter = NULL;
+
+    memcpy(jit->reg, all_registers->registers, sizeof(jit->reg));
+    jit->executed = budget->executed;
+    jit->budget = budget;
+    if (jit->buffer != NULL) {
+        memcpy(&enter, &jit->enter, sizeof(enter));
+    }
+
+    while (pc < jit->length) {
+        uint8_t *block = jit->entry[pc];
+        enum Jit_exit why = JIT_BAIL;
+
+        if (block == NULL) {
+            block = translate(jit, pc);
+        }
+        if (block != NULL) {
+            why = enter(jit, block);
+            pc = jit->pc;
+        }
+
+        if (why == JIT_BAIL) {
+            why = interpret(jit, all_registers, &pc);
+        }
+        if (why == JIT_HALT) {
+            status = EXIT_SUCCESS;
+            break;
+        }
+        if (why == JIT_PAUSE) {
+            status = UM_PAUSED;
+            break;
+        }
+    }
+
+    memcpy(all_registers->registers, jit->reg, sizeof(jit->reg));
+    *counter = pc;
+    budget->executed = jit->executed;
+    return status;
+}
@@ -0,0 +1,74 @@
+/**************************************************************
+ *                     jit.h
+ *
+ *     Assignment: Homework 6 - Universal Machine Program
+ *     Authors: Katie Yang (zyang11) and Pamela Melgar (pmelga01)
+ *     Date: November 24, 2021
+ *
+ *     Purpose: Interface for the x86-64 JIT execution engine. Basic
+ *              blocks of segment 0 are translated into native code the
+ *              first time they run; anything the translated code cannot
+ *              finish is handed to execute_instruction, which stays the
+ *              reference. It is chosen at build time (ENGINE=jit in the
+ *              Makefile) and needs an x86-64 host with the System V ABI.
+ *
+ *     Success Output:
+ *              exit_sucess
+ *
+ *     Failure output:
+ *              exit_faliure
+ *
+ **************************************************************/
+
+#ifndef JIT_H
+#define JIT_H
+
+#include <stdint.h>
+#include "memory_manager.h"
+#include "register_manager.h"
+#include "instruction_retrieval.h"
+
+/*A struct pointer to a hidden instance of the JIT*/
+typedef struct Jit *Jit;
+
+/*
+* jit_new
+* Purpose: To set up the JIT for the program in segment 0
+* Input: the Memory of the machine, with segment 0 loaded
+* Expected Output: a JIT with no blocks translated yet
+* Note: if no executable memory can be mapped, every instruction will be
+*       interpreted. Between calls to run_jit, the memory must only be 
+*       changed by run_jit.
+*/
+Jit jit_new(Memory all_segments);
+
+
+/*
+* run_jit
+* Purpose: To run the program in segment 0 from a given instruction until 
+*          it halts or runs off the end of segment 0, translating each 
+*          basic block to native code on first use
+* Input: the JIT, the Registers of the machine, a pointer to the program 
+*        counter, which is left pointing past the last instruction 
+*        executed, and the budget to count against
+* Expected Output: EXIT_SUCCESS if the program halted, EXIT_FAILURE if it
+*                  ran off the end of segment 0, UM_PAUSED if it stopped
+*                  because budget->executed reached budget->limit
+* Note: same instruction semantics as instruction_executer, including
+*       exiting with EXIT_FAILURE on an invalid opcode. Blocks are kept 
+*       from one call to the next.
+*/
+int run_jit(Jit jit, Registers all_registers, uint32_t *counter,
+            Um_budget *budget);
+
+
+/*
+* jit_free
+* Purpose: To release the JIT and its executable memory
+* Input: a pointer to a JIT
+* Expected Output: none, *jit is set to NULL
+* Note: does not touch the memory manager
+*/
+void jit_free(Jit *jit);
+
+#endif
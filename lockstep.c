@@ -0,0 +1,562 @@
+/**************************************************************
+ *                     lockstep.c
+ *
+ *     Assignment: Homework 6 - Universal Machine Program
+ *     Authors: Katie Yang (zyang11) and Pamela Melgar (pmelga01)
+ *     Date: November 24, 2021
+ *
+ *     Implementation for lockstep.h
+ *
+ *     Purpose: Runs the engine for a stretch, then the reference for
+ *              exactly as many instructions, then compares. Every engine
+ *              counts the instructions it runs exactly and can pause
+ *              after a load program, so the stretches end at block
+ *              boundaries. Each machine reads its own copy of stdin and
+ *              writes to its own buffer while it runs, so their input
+ *              and output can be compared too.
+ *
+ *     Success Output:
+ *              the program's exit status
+ *
+ *     Failure output:
+ *              LOCKSTEP_DIVERGED
+ *
+ *     Note:
+ *              Every engine writes stdout through stdio, so each machine
+ *              is given its own stream by pointing stdout at it while it
+ *              runs, which glibc allows; the output buffer is flushed
+ *              before it is pointed back. Input comes from the input
+ *              buffer, so each machine gets an Input_core of its own over
+ *              the saved input in the same way.
+ *
+ **************************************************************/
+
+#include <stdio.h>
+#include <stdarg.h>
+#include <string.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "lockstep.h"
+#include "output_buffer.h"
+#include "input_buffer.h"
+#include "assert.h"
+
+/*How many of the reference's latest instructions are kept for reports*/
+#define TRACE_LENGTH 1024
+
+/*Reference status once it reached an invalid opcode, which it does not
+  run: execute_instruction would exit*/
+#define REFERENCE_INVALID (-1)
+
+/*
+* struct Step
+* Purpose: One instruction the reference ran, kept to find the one that
+*          caused a difference
+* Members: uint32_t pc - where it was
+*          uint32_t word - the instruction
+*          uint32_t value_a, value_b - registers A and B before it ran, so
+*                   a store can be matched with the word it wrote; for a
+*                   map or unmap, value_b is the segment it changed
+*/
+struct Step
+{
+    uint32_t pc;
+    uint32_t word;
+    uint32_t value_a;
+    uint32_t value_b;
+};
+
+/*
+* struct Reference
+* Purpose: The machine that runs on execute_instruction
+* Members: Memory memory, Registers registers - its own machine state
+*          uint32_t pc - its program counter
+*          uint64_t executed - the instructions it has run
+*          int status - UM_PAUSED while the program is running, then how
+*                   it ended
+*          struct Step trace[] - its latest instructions, a ring
+*          uint64_t traced - instructions recorded since the last
+*                   comparison
+*/
+struct Reference
+{
+    Memory memory;
+    Registers registers;
+    uint32_t pc;
+    uint64_t executed;
+    int status;
+    struct Step trace[TRACE_LENGTH];
+    uint64_t traced;
+};
+
+/*
+* struct Comparison
+* Purpose: Where lockstep is, for reports
+* Members: uint64_t number - which comparison this is, from 1
+*          uint64_t first - the instruction count the stretch started at
+*          uint64_t engine_executed - the engine's count at its end
+*          const char *name - the engine's name
+*/
+struct Comparison
+{
+    uint64_t number;
+    uint64_t first;
+    uint64_t engine_executed;
+    const char *name;
+};
+
+static unsigned char *read_input(size_t *length);
+static void run_reference(struct Reference *reference, uint64_t target);
+static bool compare(const struct Comparison *at, int status, uint32_t pc,
+                    Memory memory, Registers registers,
+                    struct Reference *reference, const char *output,
+                    size_t output_size, const char *expected,
+                    size_t expected_size);
+static bool compare_memory(const struct Comparison *at, Memory memory,
+                           struct Reference *reference);
+static void report(const struct Comparison *at, struct Reference *reference,
+                   bool (*caused)(const struct Step *step, uint32_t x,
+                                  uint32_t y),
+                   uint32_t x, uint32_t y, const char *what, ...);
+static bool wrote_register(const struct Step *step, uint32_t r,
+                           uint32_t unused);
+static bool wrote_word(const struct Step *step, uint32_t segment,
+                       uint32_t word_index);
+static bool changed_mapping(const struct Step *step, uint32_t segment,
+                            uint32_t unused);
+static bool jumped(const struct Step *step, uint32_t unused_x,
+                   uint32_t unused_y);
+static bool wrote_output(const struct Step *step, uint32_t unused_x,
+                         uint32_t unused_y);
+
+/*
+* run_lockstep
+* Purpose: To run the engine and the reference a stretch at a time,
+*          comparing them after each stretch
+* Parameters: Lockstep_engine *engine, void *cl - the engine and its state
+*             const char *name - the engine's name, for reports
+*             Memory memory, Registers registers - the engine's machine,
+*                       segment 0 loaded
+*             uint64_t interval - instructions between comparisons
+* Returns: the program's exit status, or LOCKSTEP_DIVERGED
+* Notes: the reference's machine is a copy of the engine's as it starts
+*/
+int run_lockstep(Lockstep_engine *engine, void *cl, const char *name,
+                 Memory memory, Registers registers, uint64_t interval)
+{
+    assert(engine != NULL && memory != NULL && registers != NULL);
+    assert(interval > 0);
+
+    size_t input_length;
+    unsigned char *input = read_input(&input_length);
+    struct Input_core engine_in = input_over(input, input_length);
+    struct Input_core reference_in = input_over(input, input_length);
+    struct Input_core real_in = input_core;
+
+    struct Reference *reference = calloc(1, sizeof(*reference));
+    assert(reference != NULL);
+    reference->memory = initialize_memory();
+    reference->registers = initialize_registers();
+    reference->status = UM_PAUSED;
+    memcpy(reference->registers->registers, registers->registers,
+           sizeof(registers->registers));
+
+    const uint32_t *words = segment_words(memory, 0);
+    for (uint32_t i = 0; i < segmentlength(memory, 0); i++) {
+        add_to_seg0(reference->memory, words[i]);
+    }
+
+    struct Comparison at = { .number = 0, .name = name };
+    Um_budget budget = { .executed = 0, .limit = 0 };
+    uint32_t pc = 0;
+    int status = UM_PAUSED;
+    bool same = true;
+
+    while (same && status == UM_PAUSED) {
+        char *output, *expected;
+        size_t output_size, expected_size;
+        FILE *engine_out = open_memstream(&output, &output_size);
+        FILE *reference_out = open_memstream(&expected, &expected_size);
+        FILE *real_out = stdout;
+        assert(engine_out != NULL && reference_out != NULL);
+
+        at.number++;
+        at.first = budget.executed;
+        budget.limit = budget.executed > UINT64_MAX - interval ?
+                       UINT64_MAX : budget.executed + interval;
+
+        input_core = engine_in;
+        stdout = engine_out;
+        status = engine(cl, memory, registers, &pc, &budget);
+        output_flush();
+        engine_in = input_core;
+        input_core = reference_in;
+        stdout = reference_out;
+        run_reference(reference, budget.executed);
+        output_flush();
+        reference_in = input_core;
+        input_core = real_in;
+        stdout = real_out;
+        fclose(engine_out);
+        fclose(reference_out);
+
+        at.engine_executed = budget.executed;
+        same = compare(&at, status, pc, memory, registers, reference,
+                       output, output_size, expected, expected_size);
+        fwrite(expected, 1, expected_size, stdout);
+        free(output);
+        free(expected);
+    }
+    fflush(stdout);
+
+    if (same) {
+        fprintf(stderr, "um: lockstep: %s matched the reference for %llu "
+                        "instructions (%llu comparisons)\n", name,
+                (unsigned long long)budget.executed,
+                (unsigned long long)at.number);
+    }
+
+    free(input);
+    free_registers(reference->registers);
+    free_segments(reference->memory);
+    free(reference);
+    return same ? status : LOCKSTEP_DIVERGED;
+}
+
+/*
+* read_input
+* Purpose: To read all of stdin, so both machines can be given a copy
+* Parameters: size_t *length - receives the number of bytes read
+* Returns: a malloc'd buffer holding them
+*/
+static unsigned char *read_input(size_t *length)
+{
+    size_t capacity = 4096;
+    unsigned char *input = malloc(capacity);
+    assert(input != NULL);
+
+    *length = 0;
+    for (;;) {
+        *length += input_bytes(input + *length, capacity - *length);
+        if (*length < capacity) {
+            break;
+        }
+        capacity *= 2;
+        input = realloc(input, capacity);
+        assert(input != NULL);
+    }
+    return input;
+}
+
+/*
+* run_reference
+* Purpose: To run the reference until it has run target instructions or
+*          the program stops
+* Parameters: struct Reference *reference - the reference machine
+*             uint64_t target - the engine's instruction count
+* Returns: nothing; reference->status says why it stopped
+* Notes: fetches from segment 0 word by word, as instruction_executer's
+*        callers always have. An invalid opcode is not run, since the
+*        engine would have exited on it instead of stopping here.
+*/
+static void run_reference(struct Reference *reference, uint64_t target)
+{
+    Memory memory = reference->memory;
+    uint32_t *reg = reference->registers->registers;
+
+    reference->traced = 0;
+    while (reference->status == UM_PAUSED && reference->executed < target) {
+        if (reference->pc >= segmentlength(memory, 0)) {
+            reference->status = EXIT_FAILURE;
+            break;
+        }
+
+        uint32_t word = get_word(memory, 0, reference->pc);
+        struct Info info;
+        decode_instruction(word, &info);
+        if (!opcode_valid(info.op)) {
+            reference->status = REFERENCE_INVALID;
+            break;
+        }
+
+        struct Step *step = &reference->trace[reference->traced %
+                                              TRACE_LENGTH];
+        step->pc = reference->pc;
+        step->word = word;
+        step->value_a = reg[info.rA];
+        step->value_b = info.op == INACTIVATE ? reg[info.rC] : reg[info.rB];
+        reference->traced++;
+
+        reference->pc++;
+        reference->executed++;
+        if (!execute_instruction(&info, memory, reference->registers,
+                                 &reference->pc)) {
+            reference->status = EXIT_SUCCESS;
+        }
+        if (info.op == ACTIVATE) {
+            step->value_b = reg[info.rB];
+        }
+    }
+}
+
+/*
+* compare
+* Purpose: To compare the engine with the reference after a stretch
+* Parameters: const struct Comparison *at - which comparison this is
+*             int status, uint32_t pc - how the engine stopped, and where
+*             Memory memory, Registers registers - the engine's machine
+*             struct Reference *reference - the reference
+*             const char *output, expected - what the engine and the
+*                       reference wrote during the stretch, with sizes
+* Returns: true if they agree; otherwise the first difference has been
+*          reported
+*/
+static bool compare(const struct Comparison *at, int status, uint32_t pc,
+                    Memory memory, Registers registers,
+                    struct Reference *reference, const char *output,
+                    size_t output_size, const char *expected,
+                    size_t expected_size)
+{
+    if (reference->status == REFERENCE_INVALID) {
+        report(at, reference, NULL, 0, 0, "the reference reached an "
+               "invalid instruction at pc %u", reference->pc);
+        return false;
+    }
+    if (status != reference->status ||
+        at->engine_executed != reference->executed) {
+        report(at, reference, jumped, 0, 0, "the engine stopped with "
+               "status %d after %llu instructions, the reference with "
+               "status %d after %llu", status,
+               (unsigned long long)at->engine_executed, reference->status,
+               (unsigned long long)reference->executed);
+        return false;
+    }
+    if (pc != reference->pc) {
+        report(at, reference, jumped, 0, 0, "pc is %u, the reference's %u",
+               pc, reference->pc);
+        return false;
+    }
+
+    const uint32_t *reg = registers->registers;
+    const uint32_t *expected_reg = reference->registers->registers;
+    for (uint32_t r = 0; r < NUM_REGISTERS; r++) {
+        if (reg[r] != expected_reg[r]) {
+            report(at, reference, wrote_register, r, 0, "r%u is 0x%08x, "
+                   "the reference's 0x%08x", r, reg[r], expected_reg[r]);
+            return false;
+        }
+    }
+
+    if (output_size != expected_size ||
+        memcmp(output, expected, output_size) != 0) {
+        report(at, reference, wrote_output, 0, 0, "the engine wrote %zu "
+               "bytes, the reference %zu, and they differ", output_size,
+               expected_size);
+        return false;
+    }
+
+    return compare_memory(at, memory, reference);
+}
+
+/*
+* compare_memory
+* Purpose: To compare every mapped segment of the two machines
+* Parameters: const struct Comparison *at - which comparison this is
+*             Memory memory - the engine's segments
+*             struct Reference *reference - the reference
+* Returns: true if the same IDs are mapped with the same words
+* Notes: a memcmp per segment. Only segment 0's stored-into words are
+*        tracked by the memory manager, so the words a stretch changed
+*        are found by comparing all of them.
+*/
+static bool compare_memory(const struct Comparison *at, Memory memory,
+                           struct Reference *reference)
+{
+    uint32_t ids = memorylength(memory);
+
+    if (memorylength(reference->memory) > ids) {
+        ids = memorylength(reference->memory);
+    }
+
+    for (uint32_t id = 0; id < ids; id++) {
+        struct Descriptor *mine = memory_find(memory, id);
+        struct Descriptor *theirs = memory_find(reference->memory, id);
+
+        if (mine == NULL && theirs == NULL) {
+            continue;
+        }
+        if (mine == NULL || theirs == NULL ||
+            mine->length != theirs->length) {
+            report(at, reference, changed_mapping, id, 0, "segment %u is "
+                   "%s with %u words, the reference's %s with %u", id,
+                   mine == NULL ? "unmapped" : "mapped",
+                   mine == NULL ? 0 : mine->length,
+                   theirs == NULL ? "unmapped" : "mapped",
+                   theirs == NULL ? 0 : theirs->length);
+            return false;
+        }
+        if (memcmp(mine->base, theirs->base,
+                   (size_t)mine->length * sizeof(uint32_t)) == 0) {
+            continue;
+        }
+        for (uint32_t i = 0; i < mine->length; i++) {
+            if (mine->base[i] != theirs->base[i]) {
+                report(at, reference, wrote_word, id, i, "m[%u][%u] is "
+                       "0x%08x, the reference's 0x%08x", id, i,
+                       mine->base[i], theirs->base[i]);
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+/*
+* report
+* Purpose: To report a difference on stderr with the instruction that
+*          caused it: the last instruction of the stretch for which
+*          caused is true, or the stretch's first one if none is
+* Parameters: const struct Comparison *at - which comparison found it
+*             struct Reference *reference - the reference and its trace
+*             caused, x, y - the test for the instruction to blame, and
+*                       its arguments; NULL blames nothing
+*             const char *what, ... - the difference, printf style
+* Returns: nothing
+*/
+static void report(const struct Comparison *at, struct Reference *reference,
+                   bool (*caused)(const struct Step *step, uint32_t x,
+                                  uint32_t y),
+                   uint32_t x, uint32_t y, const char *what, ...)
+{
+    va_list args;
+
+    fprintf(stderr, "um: lockstep: %s diverged from the reference in "
+                    "comparison %llu, instructions %llu to %llu\n",
+            at->name, (unsigned long long)at->number,
+            (unsigned long long)at->first,
+            (unsigned long long)at->engine_executed);
+    fprintf(stderr, "um: lockstep:   ");
+    va_start(args, what);
+    vfprintf(stderr, what, args);
+    va_end(args);
+    fprintf(stderr, "\n");
+
+    uint64_t kept = reference->traced < TRACE_LENGTH ?
+                    reference->traced : TRACE_LENGTH;
+    const struct Step *blamed = NULL;
+
+    for (uint64_t back = 1; caused != NULL && back <= kept; back++) {
+        const struct Step *step = &reference->trace[(reference->traced -
+                                                     back) % TRACE_LENGTH];
+        if (caused(step, x, y)) {
+            blamed = step;
+            break;
+        }
+    }
+    if (blamed == NULL && kept > 0) {
+        blamed = &reference->trace[(reference->traced - kept) %
+                                   TRACE_LENGTH];
+        fprintf(stderr, "um: lockstep:   no instruction in the last %llu "
+                        "of the stretch explains it; the earliest kept "
+                        "is:\n", (unsigned long long)kept);
+    }
+    if (blamed == NULL) {
+        return;
+    }
+
+    struct Info info;
+    decode_instruction(blamed->word, &info);
+    if (info.op == LV) {
+        fprintf(stderr, "um: lockstep:   first diverging instruction: pc "
+                        "%u, word 0x%08x (LV r%u %u)\n", blamed->pc,
+                blamed->word, info.rA, info.value);
+    }
+    else {
+        fprintf(stderr, "um: lockstep:   first diverging instruction: pc "
+                        "%u, word 0x%08x (%s r%u r%u r%u)\n", blamed->pc,
+                blamed->word, opcode_name(info.op), info.rA, info.rB,
+                info.rC);
+    }
+}
+
+/*
+* The tests report uses to find the instruction behind a difference. Each
+* takes a traced step and the register, segment or word that differs.
+*/
+
+/*an instruction that sets register r*/
+static bool wrote_register(const struct Step *step, uint32_t r,
+                           uint32_t unused)
+{
+    struct Info info;
+
+    (void)unused;
+    decode_instruction(step->word, &info);
+    switch (info.op) {
+    case CMOV: case SLOAD: case ADD: case MUL: case DIV: case NAND:
+    case LV:
+        return info.rA == r;
+    case ACTIVATE:
+        return info.rB == r;
+    case BCOPY:
+        return info.value == BULK_READ && info.rB == r;
+    case IN:
+        return info.rC == r;
+    default:
+        return false;
+    }
+}
+
+/*a store into m[segment][word_index], or a bulk store into segment*/
+static bool wrote_word(const struct Step *step, uint32_t segment,
+                       uint32_t word_index)
+{
+    struct Info info;
+
+    decode_instruction(step->word, &info);
+    return (info.op == SSTORE && step->value_a == segment &&
+            step->value_b == word_index) ||
+           ((info.op == BCOPY || info.op == FILL) &&
+            info.value != BULK_WRITE && step->value_a == segment) ||
+           changed_mapping(step, segment, word_index);
+}
+
+/*a map or unmap of segment, or a load program that replaced segment 0*/
+static bool changed_mapping(const struct Step *step, uint32_t segment,
+                            uint32_t unused)
+{
+    struct Info info;
+
+    (void)unused;
+    decode_instruction(step->word, &info);
+    if (info.op == ACTIVATE || info.op == INACTIVATE) {
+        return step->value_b == segment;
+    }
+    return info.op == LOADP && segment == 0 && step->value_b != 0;
+}
+
+/*a load program or halt*/
+static bool jumped(const struct Step *step, uint32_t unused_x,
+                   uint32_t unused_y)
+{
+    struct Info info;
+
+    (void)unused_x;
+    (void)unused_y;
+    decode_instruction(step->word, &info);
+    return info.op == LOADP || info.op == HALT;
+}
+
+/*an output*/
+static bool wrote_output(const struct Step *step, uint32_t unused_x,
+                         uint32_t unused_y)
+{
+    struct Info info;
+
+    (void)unused_x;
+    (void)unused_y;
+    decode_instruction(step->word, &info);
+    return info.op == OUT || (info.op == BCOPY && info.value == BULK_WRITE);
+}
@@ -0,0 +1,62 @@
+/**************************************************************
+ *                     lockstep.h
+ *
+ *     Assignment: Homework 6 - Universal Machine Program
+ *     Authors: Katie Yang (zyang11) and Pamela Melgar (pmelga01)
+ *     Date: November 24, 2021
+ *
+ *     Purpose: Interface for lockstep mode (--lockstep). The program is
+ *              run on the engine the build selected and, beside it, on
+ *              a second machine that runs every instruction through
+ *              execute_instruction, the reference interpreter. At block
+ *              boundaries the two are compared: registers, program
+ *              counter, instruction count, every mapped segment and the
+ *              output so far. The first difference is reported with the
+ *              instruction that caused it.
+ *
+ *     Success Output:
+ *              the program's output and exit status, and a summary on
+ *              stderr
+ *
+ *     Failure output:
+ *              a report on stderr and exit status LOCKSTEP_DIVERGED
+ *
+ **************************************************************/
+
+#ifndef LOCKSTEP_H
+#define LOCKSTEP_H
+
+#include <stdint.h>
+#include "memory_manager.h"
+#include "register_manager.h"
+#include "instruction_retrieval.h"
+
+/*Exit status when the engine and the reference disagree*/
+#define LOCKSTEP_DIVERGED 2
+
+/*
+* An execution engine as lockstep runs it: like run_threaded or run_jit,
+* with its own state in cl, running the machine in memory and registers
+* from *counter until it halts, fails or pauses for its budget
+*/
+typedef int Lockstep_engine(void *cl, Memory memory, Registers registers,
+                            uint32_t *counter, Um_budget *budget);
+
+/*
+* run_lockstep
+* Purpose: To run the program on an engine and on the reference side by
+*          side, comparing them at block boundaries
+* Input: the engine, its closure and name (for reports), the Memory and
+*        Registers it runs on, with segment 0 loaded and nothing run yet,
+*        and the number of instructions between comparisons
+* Expected Output: the program's exit status if the engine matched the
+*                  reference throughout, else LOCKSTEP_DIVERGED
+* Note: all of stdin is read before the program starts, so both machines
+*       see the same input. A comparison happens at the first load
+*       program after each interval instructions, where every engine can
+*       stop. The reference's output is what reaches stdout.
+*/
+int run_lockstep(Lockstep_engine *engine, void *cl, const char *name,
+                 Memory memory, Registers registers, uint64_t interval);
+
+#endif
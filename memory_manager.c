@@ -26,38 +26,626 @@
 #include <stdio.h>
 #include <string.h>
 #include <stdlib.h>
+#include <stddef.h>
 #include <stdint.h>
+#include <stdbool.h>
+#include <unistd.h>
+#include <sys/mman.h>
 
 #include "memory_manager.h"
-#include "seq.h"
-#include "bitpack.h"
 #include "assert.h"
 
 #define BYTESIZE 8
 
+/*Smallest pooled block holds 2^1 words: enough room for a free-list link*/
+#define MIN_CLASS 1
+/*Largest pooled block holds 2^(NUM_SIZE_CLASSES - 1) words*/
+#define MAX_CLASS (NUM_SIZE_CLASSES - 1)
+/*Size of each region chunk that pooled blocks are carved out of*/
+#define CHUNK_BYTES ((size_t)1 << 22)
+#define ALIGNMENT 16
+#define ALIGN_UP(n) (((n) + (ALIGNMENT - 1)) & ~(size_t)(ALIGNMENT - 1))
+
+/*Transparent huge pages are 2 MB on x86-64*/
+#define HUGE_PAGE ((size_t)1 << 21)
+/*In huge-page mode, mapped segments at least this many words get THP*/
+#define HUGE_THRESHOLD_WORDS (HUGE_PAGE / sizeof(uint32_t))
+/*How many unmapped huge chunks are kept (emptied) for reuse*/
+#define MAX_SPARES 8
+#define TABLE_HINT 64
+/*Marks the end of the free-ID stack and an empty lookaside*/
+#define NO_SEGMENT UINT32_MAX
+
+/*
+* struct Chunk
+* Purpose: The header of one piece of the region that backs every segment.
+*          Pooled blocks are bump-allocated out of CHUNK_BYTES chunks, and 
+*          every block too large for a size class is a sparse segment: it 
+*          gets a chunk of its own, mapped from demand-zero anonymous pages
+*          so only the pages the program actually touches consume memory.
+* Members: struct Chunk *prev, *next - links in the doubly-linked list of 
+*                   chunks owned by the memory manager, so a dedicated 
+*                   chunk can be released as soon as its segment is unmapped
+*          size_t mapped_bytes - the length of the mapping for a sparse 
+*                   segment's chunk, or 0 for a malloc'd pool chunk
+*          bool huge - whether the mapping is 2 MB aligned and advised 
+*                   to use transparent huge pages
+* Notes: Releasing the whole machine is a walk over chunks, never over 
+*        segments or words
+*/
+struct Chunk
+{
+    struct Chunk *prev;
+    struct Chunk *next;
+    size_t mapped_bytes;
+    bool huge;
+};
+
+#define CHUNK_HEADER ALIGN_UP(sizeof(struct Chunk))
+
 /*
 * struct Memory
 * Purpose: To manage the segments used throughout the program and keep
 *          secrets from the client of how these segments are represented 
 *          under-the-hood.
-* Members: Seq_T segments - the data structure to hold the memory segments
-*                   used throughout the program. Each segment Sequence will 
-*                   contain a Sequence of word instructions
-*          Seq_T map_queue - the data structure to keep track of which 
-*                   segments within the memory manager have been unmapped, 
-*                   "or killed". This keeping track is important so that 
-*                   when a new segment is desired, the queue will quickly  
-*                   retrieve the oldest unmapped segment index to 
-*                   revive/recycle whenever possible.
+* Members: struct Memory_core core - the descriptor table and lookaside 
+*                   read by the inline get_word and set_word (see 
+*                   memory_manager.h). It must stay the first member.
+*          uint32_t table_capacity - the number of descriptors allocated
+*          uint32_t free_head - the top of the stack of unmapped IDs, 
+*                   threaded through the descriptors themselves so that 
+*                   recycling an ID never allocates. This keeping track is 
+*                   important so that when a new segment is desired, the 
+*                   most recently unmapped ID is revived/recycled whenever 
+*                   possible.
+*          struct Chunk *chunks - the region: every chunk of memory that 
+*                   segment blocks live in
+*          char *bump, *bump_end - the unused tail of the newest chunk 
+*                   that pooled blocks are carved from
+*          struct Segment *free_lists[] - per size class, the blocks of 
+*                   unmapped segments waiting to be reused by map_segment
+*          Memory_stats stats - the footprint accounting and the pool's 
+*                   hit/miss counters for sizing the classes
+*          uint64_t quota_words - the most words the program may have 
+*                   live at once, or 0 for no limit
+*          uint64_t table_words - the words of descriptor table added 
+*                   since the first TABLE_HINT entries, which count 
+*                   against the quota as if they were live
+*          bool hugepages - whether segment 0 and large segments are 
+*                   placed in 2 MB transparent-huge-page regions
+*          struct Chunk *spares - unmapped huge chunks whose pages have 
+*                   been given back to the kernel, kept for reuse
+*          unsigned spare_count - the length of the spares list
+*          size_t page_bytes - the size of a base page
+*          uint64_t seg0_generation - bumped whenever segment 0 is replaced
+*                   or grown, so cached decodings of it can tell they are 
+*                   stale
+*          uint64_t *seg0_dirty - one bit per word of segment 0 written by 
+*                   set_word since the dirty bits were last cleared
+*          uint32_t dirty_bits - how many words seg0_dirty has room for
+*          uint32_t dirty_lo, dirty_hi - the range of words holding every 
+*                   set bit (dirty_lo > dirty_hi when nothing is dirty)
 * Notes: The client cannot see this struct Memory implmentation, and will 
 *        only have access to a pointer to this struct
 */
-    struct Memory
+struct Memory
 {
-    Seq_T segments;
-    Seq_T map_queue;
+    struct Memory_core core;
+    uint32_t table_capacity;
+    uint32_t free_head;
+
+    struct Chunk *chunks;
+    char *bump;
+    char *bump_end;
+    struct Segment *free_lists[NUM_SIZE_CLASSES];
+    Memory_stats stats;
+    uint64_t quota_words;
+    uint64_t table_words;
+
+    bool hugepages;
+    struct Chunk *spares;
+    unsigned spare_count;
+    size_t page_bytes;
+
+    uint64_t seg0_generation;
+    uint64_t *seg0_dirty;
+    uint32_t dirty_bits;
+    uint32_t dirty_lo;
+    uint32_t dirty_hi;
 };
 
+/*What an empty lookaside points at: no segment is mapped here, so an ID 
+  that matches last_id by accident (NO_SEGMENT is one a program can name) 
+  fails the unmapped check instead of reading a freed table*/
+static struct Descriptor no_descriptor = { .base = NULL };
+
+/*
+* out_of_memory
+* Purpose: To fail the program cleanly when the host cannot give it memory
+* Parameters: const char *what - what could not be allocated
+* Returns: never
+* Notes: exits with EXIT_FAILURE after a message on stderr, as going over 
+*        the quota does
+*/
+static void out_of_memory(const char *what)
+{
+    fprintf(stderr, "um: out of memory: cannot allocate %s\n", what);
+    exit(EXIT_FAILURE);
+}
+
+/*
+* size_class
+* Purpose: To find the smallest size class whose blocks can hold num_words
+* Parameters: uint32_t num_words - the number of words needed
+* Returns: the size class, or NUM_SIZE_CLASSES if the block is too large 
+*          to be pooled
+*/
+static unsigned size_class(uint32_t num_words)
+{
+    unsigned class = MIN_CLASS;
+
+    while (class < NUM_SIZE_CLASSES && ((uint32_t)1 << class) < num_words) {
+        class++;
+    }
+    return class;
+}
+
+/*
+* link_chunk
+* Purpose: To add a chunk to the front of the region owned by memory
+* Parameters: struct Memory *memory - the owning memory manager
+*             struct Chunk *chunk - an unlinked chunk
+* Returns: a pointer to the first usable byte of the chunk
+*/
+static char *link_chunk(struct Memory *memory, struct Chunk *chunk)
+{
+    chunk->prev = NULL;
+    chunk->next = memory->chunks;
+    if (memory->chunks != NULL) {
+        memory->chunks->prev = chunk;
+    }
+    memory->chunks = chunk;
+
+    return (char *)chunk + CHUNK_HEADER;
+}
+
+/*
+* unlink_chunk
+* Purpose: To remove a chunk from the region owned by memory
+* Parameters: struct Memory *memory - the owning memory manager
+*             struct Chunk *chunk - a chunk currently in the region
+* Returns: nothing
+*/
+static void unlink_chunk(struct Memory *memory, struct Chunk *chunk)
+{
+    if (chunk->prev != NULL) {
+        chunk->prev->next = chunk->next;
+    } else {
+        memory->chunks = chunk->next;
+    }
+    if (chunk->next != NULL) {
+        chunk->next->prev = chunk->prev;
+    }
+}
+
+/*
+* new_chunk
+* Purpose: To allocate a chunk of "bytes" usable bytes and link it into 
+*          the region owned by memory
+* Parameters: struct Memory *memory - the owning memory manager
+*             size_t bytes - the usable size, not counting the header
+* Returns: a pointer to the first usable byte of the chunk
+* Notes: Will fail if memory cannot be allocated
+*/
+static char *new_chunk(struct Memory *memory, size_t bytes)
+{
+    struct Chunk *chunk = malloc(CHUNK_HEADER + bytes);
+    if (chunk == NULL) {
+        out_of_memory("a segment chunk");
+    }
+
+    memory->stats.reserved_bytes += CHUNK_HEADER + bytes;
+    chunk->mapped_bytes = 0;
+    chunk->huge = false;
+    return link_chunk(memory, chunk);
+}
+
+/*
+* map_chunk
+* Purpose: To map "bytes" bytes of demand-zero anonymous memory for a 
+*          dedicated chunk. The kernel supplies zeroed pages as they are 
+*          first touched, so the cost of this call does not depend on its 
+*          size. A huge chunk is rounded to and aligned on 2 MB and advised 
+*          to use transparent huge pages.
+* Parameters: size_t bytes - the size including the chunk header
+*             bool huge - whether to place the chunk in huge pages
+* Returns: the unlinked chunk, with mapped_bytes and huge filled in
+* Notes: Will fail if the address space cannot be reserved
+*/
+static struct Chunk *map_chunk(size_t bytes, bool huge)
+{
+    int flags = MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE;
+    struct Chunk *chunk;
+
+    if (!huge) {
+        chunk = mmap(NULL, bytes, PROT_READ | PROT_WRITE, flags, -1, 0);
+        if (chunk == MAP_FAILED) {
+            out_of_memory("a segment chunk");
+        }
+    } else {
+        /*over-map by one huge page, then trim both ends to alignment*/
+        bytes = (bytes + HUGE_PAGE - 1) & ~(HUGE_PAGE - 1);
+        char *raw = mmap(NULL, bytes + HUGE_PAGE, PROT_READ | PROT_WRITE, 
+                         flags, -1, 0);
+        if (raw == MAP_FAILED) {
+            out_of_memory("a segment chunk");
+        }
+
+        char *aligned = (char *)(((uintptr_t)raw + HUGE_PAGE - 1) & 
+                                 ~(uintptr_t)(HUGE_PAGE - 1));
+        if (aligned != raw) {
+            munmap(raw, aligned - raw);
+        }
+        munmap(aligned + bytes, (raw + HUGE_PAGE) - aligned);
+
+        /*advisory only: kernels without THP simply keep base pages*/
+        madvise(aligned, bytes, MADV_HUGEPAGE);
+        chunk = (struct Chunk *)aligned;
+    }
+
+    chunk->mapped_bytes = bytes;
+    chunk->huge = huge;
+    return chunk;
+}
+
+/*
+* take_spare
+* Purpose: To reuse an emptied huge chunk of at least "bytes" bytes 
+*          instead of mapping a new one
+* Parameters: struct Memory *memory - the owning memory manager
+*             size_t bytes - the size needed, including the chunk header
+* Returns: the unlinked chunk with every byte past its header zero, or 
+*          NULL if no spare is large enough
+*/
+static struct Chunk *take_spare(struct Memory *memory, size_t bytes)
+{
+    struct Chunk **link = &memory->spares;
+
+    while (*link != NULL && (*link)->mapped_bytes < bytes) {
+        link = &(*link)->next;
+    }
+
+    struct Chunk *chunk = *link;
+    if (chunk != NULL) {
+        *link = chunk->next;
+        memory->spare_count--;
+
+        /*the first page kept its contents when the rest was discarded*/
+        memset((char *)chunk + CHUNK_HEADER, 0, 
+               memory->page_bytes - CHUNK_HEADER);
+        memory->stats.pool.spare_reuses++;
+    }
+    return chunk;
+}
+
+/*
+* new_mapped_segment
+* Purpose: To give a block a dedicated mapped chunk: a sparse segment 
+*          whose zeroed pages appear only as they are touched. In huge-page
+*          mode, segment 0 and blocks of at least HUGE_THRESHOLD_WORDS 
+*          go into a 2 MB aligned THP region, reusing a spare one if possible
+* Parameters: struct Memory *memory - the owning memory manager
+*             uint32_t length - the number of words visible to the program
+*             uint32_t capacity - the minimum number of words to make room for
+*             bool for_segment0 - whether the block is for segment 0
+* Returns: the new block, already zero
+*/
+static struct Segment *new_mapped_segment(struct Memory *memory, 
+                                          uint32_t length, uint32_t capacity,
+                                          bool for_segment0)
+{
+    size_t bytes = CHUNK_HEADER + sizeof(struct Segment) + 
+                   (size_t)capacity * sizeof(uint32_t);
+    bool huge = memory->hugepages && 
+                (for_segment0 || capacity >= HUGE_THRESHOLD_WORDS);
+    struct Chunk *chunk = NULL;
+
+    if (huge) {
+        chunk = take_spare(memory, bytes);
+    }
+    if (chunk == NULL) {
+        chunk = map_chunk(bytes, huge);
+        memory->stats.pool.sparse_maps++;
+        memory->stats.pool.huge_maps += huge;
+    }
+    memory->stats.reserved_bytes += chunk->mapped_bytes;
+
+    struct Segment *segment = (struct Segment *)link_chunk(memory, chunk);
+
+    /*a rounded-up huge chunk has room to spare: let segment 0 grow into it*/
+    size_t room = (chunk->mapped_bytes - CHUNK_HEADER - 
+                   sizeof(struct Segment)) / sizeof(uint32_t);
+    if (room > UINT32_MAX) {
+        room = UINT32_MAX;
+    }
+
+    /*the mapping is already zero, touching it here would defeat it*/
+    segment->length = length;
+    segment->capacity = room;
+    segment->refs = 1;
+    segment->mapped = 1;
+    return segment;
+}
+
+/*
+* free_chunk
+* Purpose: To return a single chunk to the system, however it was obtained
+* Parameters: struct Chunk *chunk - the chunk, already unlinked or about 
+*                   to be discarded with the rest of the region
+* Returns: nothing
+*/
+static void free_chunk(struct Chunk *chunk)
+{
+    if (chunk->mapped_bytes != 0) {
+        munmap(chunk, chunk->mapped_bytes);
+    } else {
+        free(chunk);
+    }
+}
+
+/*
+* new_segment
+* Purpose: To get a single contiguous block able to hold "capacity" words, 
+*          with the first "length" of them initialized to 0. The block is 
+*          taken from its size class's free list when one is waiting there 
+*          (a hit), otherwise carved out of the region (a miss). Blocks too 
+*          large for any size class are sparse: they get a dedicated chunk 
+*          of demand-zero pages and are never zeroed by hand.
+* Parameters: struct Memory *memory - the memory manager that owns the pool
+*             uint32_t length - the number of words visible to the program
+*             uint32_t capacity - the minimum number of words to make room for
+* Returns: a pointer to the struct Segment
+* Notes: Will fail if memory cannot be allocated, capacity >= length
+*/
+static struct Segment *new_segment(struct Memory *memory, uint32_t length, 
+                                   uint32_t capacity)
+{
+    unsigned class = size_class(capacity);
+    struct Segment *segment;
+
+    if (class > MAX_CLASS) {
+        return new_mapped_segment(memory, length, capacity, false);
+    } 
+    else if (memory->free_lists[class] != NULL) {
+        segment = memory->free_lists[class];
+        memcpy(&memory->free_lists[class], segment->words, 
+               sizeof(struct Segment *));
+
+        capacity = (uint32_t)1 << class;
+        memory->stats.pool.hits[class]++;
+        memory->stats.pool.bytes_retained -= sizeof(struct Segment) + 
+                                        (size_t)capacity * sizeof(uint32_t);
+    } 
+    else {
+        capacity = (uint32_t)1 << class;
+        size_t bytes = ALIGN_UP(sizeof(struct Segment) + 
+                                (size_t)capacity * sizeof(uint32_t));
+
+        if ((size_t)(memory->bump_end - memory->bump) < bytes) {
+            /*the unused tail of the old chunk is simply abandoned*/
+            memory->bump = new_chunk(memory, CHUNK_BYTES);
+            memory->bump_end = memory->bump + CHUNK_BYTES;
+        }
+        segment = (struct Segment *)memory->bump;
+        memory->bump += bytes;
+        memory->stats.pool.misses[class]++;
+    }
+
+    segment->length = length;
+    segment->capacity = capacity;
+    segment->refs = 1;
+    segment->mapped = 0;
+    memset(segment->words, 0, (size_t)length * sizeof(uint32_t));
+
+    return segment;
+}
+
+/*
+* release_segment
+* Purpose: To give the block of an unmapped segment back to the pool. 
+*          Pooled blocks go on their size class's free list for reuse. 
+*          Huge chunks have their pages handed back to the kernel with 
+*          MADV_DONTNEED and are kept (up to MAX_SPARES) to be reused 
+*          without a new mapping; other mapped chunks are unmapped.
+* Parameters: struct Memory *memory - the memory manager that owns the pool
+*             struct Segment *segment - the block to release
+* Returns: nothing
+* Notes: segment must have come from new_segment on the same memory
+*/
+static void release_segment(struct Memory *memory, struct Segment *segment)
+{
+    if (segment->mapped) {
+        struct Chunk *chunk = (struct Chunk *)((char *)segment - 
+                                               CHUNK_HEADER);
+        unlink_chunk(memory, chunk);
+        memory->stats.reserved_bytes -= chunk->mapped_bytes;
+
+        if (chunk->huge && memory->spare_count < MAX_SPARES) {
+            /*keep the address range and first page, drop the rest*/
+            madvise((char *)chunk + memory->page_bytes, 
+                    chunk->mapped_bytes - memory->page_bytes, 
+                    MADV_DONTNEED);
+            chunk->next = memory->spares;
+            memory->spares = chunk;
+            memory->spare_count++;
+        } else {
+            free_chunk(chunk);
+        }
+        return;
+    }
+
+    unsigned class = size_class(segment->capacity);
+
+    memcpy(segment->words, &memory->free_lists[class], 
+           sizeof(struct Segment *));
+    memory->free_lists[class] = segment;
+    memory->stats.pool.bytes_retained += sizeof(struct Segment) + 
+                                    (size_t)segment->capacity * 
+                                    sizeof(uint32_t);
+}
+
+/*
+* check_quota
+* Purpose: To fail the program cleanly if "words" more words would take it 
+*          past its quota
+* Parameters: struct Memory *memory - the memory manager
+*             uint64_t words - the number of words about to be used
+* Returns: nothing
+* Notes: the grown part of the descriptor table counts as live, so 
+*        mapping many small or empty segments is limited too
+*/
+static void check_quota(struct Memory *memory, uint64_t words)
+{
+    uint64_t live = memory->stats.live_words + memory->table_words;
+
+    if (memory->quota_words != 0 && live + words > memory->quota_words) {
+        fprintf(stderr, "um: memory quota of %llu words exceeded "
+                        "(%llu live, %llu more requested)\n", 
+                (unsigned long long)memory->quota_words, 
+                (unsigned long long)live, 
+                (unsigned long long)words);
+        exit(EXIT_FAILURE);
+    }
+}
+
+/*
+* charge
+* Purpose: To account for "words" more words becoming live, failing the 
+*          program cleanly if that would take it past its quota
+* Parameters: struct Memory *memory - the memory manager
+*             uint64_t words - the number of words about to become live
+* Returns: nothing
+* Notes: exits with EXIT_FAILURE, after a message on stderr, instead of 
+*        letting a runaway program exhaust the host
+*/
+static void charge(struct Memory *memory, uint64_t words)
+{
+    uint64_t live = memory->stats.live_words + words;
+
+    check_quota(memory, words);
+    memory->stats.live_words = live;
+    if (live > memory->stats.peak_words) {
+        memory->stats.peak_words = live;
+    }
+}
+
+/*
+* drop_segment
+* Purpose: To give up one segment index's claim on a block, releasing the 
+*          block to the pool (and its words from the live count) only once 
+*          no other index shares it
+* Parameters: struct Memory *memory - the memory manager that owns the pool
+*             struct Segment *segment - the block to drop
+* Returns: nothing
+*/
+static void drop_segment(struct Memory *memory, struct Segment *segment)
+{
+    if (--segment->refs == 0) {
+        memory->stats.live_words -= segment->length;
+        release_segment(memory, segment);
+    }
+}
+
+/*
+* install_segment
+* Purpose: To point the descriptor of segment_index at a block
+* Parameters: struct Memory *memory - the memory manager
+*             uint32_t segment_index - an ID below table_length
+*             struct Segment *segment - the block the ID now refers to
+* Returns: nothing
+*/
+static void install_segment(struct Memory *memory, uint32_t segment_index, 
+                            struct Segment *segment)
+{
+    struct Descriptor *descriptor = &memory->core.table[segment_index];
+
+    descriptor->base = segment->words;
+    descriptor->length = segment->length;
+    descriptor->state = SEG_BLOCK;
+}
+
+/*
+* install_inline
+* Purpose: To make segment_index an inline segment of "length" words
+* Parameters: struct Memory *memory - the memory manager
+*             uint32_t segment_index - an ID below table_length
+*             uint32_t length - at most INLINE_WORDS
+*             const uint32_t *words - the initial contents, or NULL for zeros
+* Returns: nothing
+*/
+static void install_inline(struct Memory *memory, uint32_t segment_index, 
+                           uint32_t length, const uint32_t *words)
+{
+    struct Descriptor *descriptor = &memory->core.table[segment_index];
+
+    if (words != NULL) {
+        memmove(descriptor->inline_words, words, length * sizeof(uint32_t));
+    } else {
+        memset(descriptor->inline_words, 0, length * sizeof(uint32_t));
+    }
+    descriptor->base = descriptor->inline_words;
+    descriptor->length = length;
+    descriptor->state = SEG_INLINE;
+}
+
+/*
+* new_block_for
+* Purpose: To get an empty block of at least "capacity" words that is 
+*          about to become segment_index's. Segment 0 goes into the 
+*          huge-page arena when huge-page mode is on.
+* Parameters: struct Memory *memory - the memory manager that owns the pool
+*             uint32_t segment_index - the ID the block is for
+*             uint32_t capacity - the minimum number of words to make room for
+* Returns: the block, with length 0
+*/
+static struct Segment *new_block_for(struct Memory *memory, 
+                                     uint32_t segment_index, 
+                                     uint32_t capacity)
+{
+    if (segment_index == 0 && memory->hugepages) {
+        return new_mapped_segment(memory, 0, capacity, true);
+    }
+    return new_segment(memory, 0, capacity);
+}
+
+/*
+* unshare_segment
+* Purpose: To give segment_index a private copy of a block it shares with 
+*          another index, so that a store through it is not seen by the 
+*          other. This is the deferred half of load program's copy.
+* Parameters: struct Memory *memory - the memory manager that owns the pool
+*             uint32_t segment_index - the index about to be written
+*             struct Segment *shared - the block currently at that index
+* Returns: the private copy now installed at segment_index
+*/
+static struct Segment *unshare_segment(struct Memory *memory, 
+                                       uint32_t segment_index, 
+                                       struct Segment *shared)
+{
+    charge(memory, shared->length);
+    struct Segment *copy = new_block_for(memory, segment_index, 
+                                         shared->length);
+
+    memcpy(copy->words, shared->words, 
+           (size_t)shared->length * sizeof(uint32_t));
+    copy->length = shared->length;
+
+    shared->refs--;
+    install_segment(memory, segment_index, copy);
+
+    return copy;
+}
+
 /*
 * initialize_memory
 * Purpose: To create an instance of a Memory_manager struct pointer that will 
@@ -72,14 +660,24 @@
 */
  struct Memory *initialize_memory()
  {
-     struct Memory *memory = malloc(sizeof(struct Memory));
+     struct Memory *memory = calloc(1, sizeof(struct Memory));
      assert(memory != NULL);
 
-     memory->segments = Seq_new(30);
-     memory->map_queue = Seq_new(30);
-     Seq_T segment0 = Seq_new(10);
+     int failed = posix_memalign((void **)&memory->core.table, CACHE_LINE, 
+                                 TABLE_HINT * sizeof(struct Descriptor));
+     assert(failed == 0);
+     memory->table_capacity = TABLE_HINT;
+     memory->stats.reserved_bytes = TABLE_HINT * sizeof(struct Descriptor);
+     memory->free_head = NO_SEGMENT;
+     memory->core.last_id = NO_SEGMENT;
+     memory->core.last = &no_descriptor;
+     memory->page_bytes = (size_t)sysconf(_SC_PAGESIZE);
+     memory->dirty_lo = UINT32_MAX;
 
-     Seq_addhi(memory->segments, segment0);
+     /*segment 0 starts inline and is promoted by add_to_seg0 if needed*/
+     memory->core.table_length = 1;
+     install_inline(memory, 0, 0, NULL);
+     memory->stats.live_segments = memory->stats.peak_segments = 1;
      /*added segment 0*/ 
      return memory;
  }
@@ -98,7 +696,7 @@
 uint32_t memorylength(struct Memory *memory){
     assert(memory != NULL);
 
-    return Seq_length(memory->segments);
+    return memory->core.table_length;
 }
 
 /*
@@ -116,7 +714,7 @@ uint32_t memorylength(struct Memory *memory){
 uint32_t segmentlength(struct Memory *memory, uint32_t segment_index){
     assert(memory != NULL);
 
-    return Seq_length(Seq_get(memory->segments, segment_index));
+    return memory_lookup(memory, segment_index)->length;
 }
 
 
@@ -129,84 +727,388 @@ uint32_t segmentlength(struct Memory *memory, uint32_t segment_index){
 *          in the read module
 * Parameters: struct Memory *memory - a struct pointer to an instance of 
 *                   an initalized memory manager. 
-*             uint32_t *word - a pointer to a uint32_t word instruction 
-*                   that has been read an dynamically allocated in the 
-*                   read file module
+*             uint32_t word - a uint32_t word instruction that has been 
+*                   read in the read file module
 * Returns: nothing - sets words within segment0
 * Notes: the pointer to the struct cannot be NULL
-*        the pointer to the word cannot be NULL
+*        segment 0 starts inline and is promoted to a block once it 
+*        outgrows its descriptor; after that it moves to a block of the 
+*        next size class whenever it runs out of room, so populating it 
+*        costs amortized constant time per word
 */
-void add_to_seg0(struct Memory *memory, uint32_t *word)
+void add_to_seg0(struct Memory *memory, uint32_t word)
 {
     assert(memory != NULL);
 
-    Seq_T find_segment = (Seq_T)(Seq_get(memory->segments, 0));
-    Seq_addhi(find_segment, word);
-}
+    charge(memory, 1);
+    memory->seg0_generation++;
+
+    struct Descriptor *descriptor = &memory->core.table[0];
+
+    if (descriptor->state == SEG_INLINE) {
+        if (descriptor->length < INLINE_WORDS) {
+            descriptor->base[descriptor->length++] = word;
+            return;
+        }
 
+        /*promote: move the inline words out to a block of their own*/
+        struct Segment *promoted = new_block_for(memory, 0, 
+                                                 2 * INLINE_WORDS);
+        memcpy(promoted->words, descriptor->inline_words, 
+               descriptor->length * sizeof(uint32_t));
+        promoted->length = descriptor->length;
+        install_segment(memory, 0, promoted);
+    }
+
+    struct Segment *segment0 = BLOCK_OF(descriptor->base);
+    assert(segment0->refs == 1);
+
+    if (segment0->length == segment0->capacity) {
+        struct Segment *grown = new_block_for(memory, 0, 
+                                              segment0->capacity * 2);
+        memcpy(grown->words, segment0->words, 
+               (size_t)segment0->length * sizeof(uint32_t));
+        grown->length = segment0->length;
+
+        release_segment(memory, segment0);
+        segment0 = grown;
+    }
+
+    segment0->words[segment0->length++] = word;
+    install_segment(memory, 0, segment0);
+}
 
 /*
-* get_word
-* Purpose: A getter function to retrieve a uint32_t word instruction
-*          from a desired segment in memory according to a specified segment
-*          number and word index number within that segment
+* load_seg0
+* Purpose: To fill an empty segment 0 with a whole program at once, as a 
+*          program cache does, instead of a word at a time
 * Parameters: struct Memory *memory - a struct pointer to an instance of 
-*                   an initalized memory manager. 
-*           uint32_t segment_index - an integer indiating which segment of
-*                   memory the desired word is contained.
-*           uint32_t word_in_segment - an integer indicating which index within
-*                   the desired segment that the actual desired word is 
-*                   located
-* Returns: a uint32_t word instruction value retrieved from the given indices
-* Notes: the pointer to the struct cannot be NULL
-*        Both the segment and the word index should not be out of bounds
+*                   an initalized memory manager whose segment 0 is empty
+*             const uint32_t *words - the program, already in host order
+*             uint32_t length - its number of words
+* Returns: nothing - segment 0 holds a copy of words
+* Notes: the pointer to the struct cannot be NULL. The block is sized 
+*        exactly, so loading costs one copy of the program.
 */
-uint32_t get_word(struct Memory *memory, uint32_t segment_index, 
-                  uint32_t word_in_segment)
+void load_seg0(struct Memory *memory, const uint32_t *words, 
+               uint32_t length)
 {
     assert(memory != NULL);
+    assert(words != NULL || length == 0);
+    assert(memory->core.table[0].length == 0);
 
-    Seq_T find_segment = (Seq_T)(Seq_get(memory->segments, segment_index));
-    assert(find_segment != NULL);
+    if (length <= INLINE_WORDS) {
+        for (uint32_t i = 0; i < length; i++) {
+            add_to_seg0(memory, words[i]);
+        }
+        return;
+    }
 
-    uint32_t *find_word = (uint32_t *)(Seq_get(find_segment, word_in_segment));
+    charge(memory, length);
+    memory->seg0_generation++;
 
-    return *find_word;
+    struct Segment *segment0 = new_block_for(memory, 0, length);
+    memcpy(segment0->words, words, (size_t)length * sizeof(uint32_t));
+    segment0->length = length;
+    install_segment(memory, 0, segment0);
 }
 
 
 /*
-* set_word
-* Purpose: To set/change the value of a word in a given segment of memory, 
-*          and at a specified index within the segment
+* clear_seg0_dirty
+* Purpose: To forget every word marked by mark_seg0_dirty
+* Parameters: struct Memory *memory - the memory manager
+* Returns: nothing
+* Notes: only the words between dirty_lo and dirty_hi are touched
+*/
+static void clear_seg0_dirty(struct Memory *memory)
+{
+    if (memory->dirty_lo <= memory->dirty_hi) {
+        uint32_t first = memory->dirty_lo / 64;
+        uint32_t last = memory->dirty_hi / 64;
+        memset(memory->seg0_dirty + first, 0, 
+               (last - first + 1) * sizeof(uint64_t));
+    }
+    memory->dirty_lo = UINT32_MAX;
+    memory->dirty_hi = 0;
+}
+
+/*
+* mark_seg0_dirty
+* Purpose: To record that a word of segment 0 was overwritten, so that a 
+*          decoded copy of the program can re-decode just that word
+* Parameters: struct Memory *memory - the memory manager
+*             uint32_t word_index - an in-bounds index into segment 0
+* Returns: nothing
+* Notes: the bitmap grows, zeroed, to cover segment 0 on first need
+*/
+static void mark_seg0_dirty(struct Memory *memory, uint32_t word_index)
+{
+    if (word_index >= memory->dirty_bits) {
+        uint32_t bits = memory->core.table[0].length;
+        size_t old_words = ((size_t)memory->dirty_bits + 63) / 64;
+        size_t new_words = ((size_t)bits + 63) / 64;
+
+        memory->seg0_dirty = realloc(memory->seg0_dirty, 
+                                     new_words * sizeof(uint64_t));
+        assert(memory->seg0_dirty != NULL);
+        memset(memory->seg0_dirty + old_words, 0, 
+               (new_words - old_words) * sizeof(uint64_t));
+        memory->dirty_bits = bits;
+    }
+
+    memory->seg0_dirty[word_index / 64] |= (uint64_t)1 << (word_index % 64);
+    if (word_index < memory->dirty_lo) {
+        memory->dirty_lo = word_index;
+    }
+    if (word_index > memory->dirty_hi) {
+        memory->dirty_hi = word_index;
+    }
+}
+
+/*
+* set_word_slow
+* Purpose: The out-of-line half of set_word, for the stores the inline 
+*          fast path cannot make by itself: those into a block shared by 
+*          load program, and those into segment 0, which must be marked 
+*          dirty for the decoded copy of the program
 * Input: struct Memory *memory - a struct pointer to an instance of 
 *                   an initalized memory manager. 
-*        nuint32_tt segment_index - an integer indiating which segment of
+*        uint32_t segment_index - an integer indiating which segment of
 *                   memory the desired word is contained.
 *        uint32_t word_index - an integer indicating where within the desired 
 *                   segment to change the uint32_t word value
-*       
+*        uint32_t word - the value to store
 * Expected Output: none -- setter function
-* Note: memory cannot be NULL, segment index and word in segmnet must be 
-*       in bounds
+* Note: the caller has already checked that the segment is mapped and 
+*       word_index is in bounds. A segment still sharing its block with 
+*       another index gets its own copy before the store lands.
 */
-void set_word(struct Memory *memory, uint32_t segment_index, 
-              uint32_t word_index, uint32_t word)
+void set_word_slow(struct Memory *memory, uint32_t segment_index, 
+                   uint32_t word_index, uint32_t word)
 {
     assert(memory != NULL);
 
+    struct Descriptor *find_segment = memory_lookup(memory, segment_index);
+    uint32_t *base = find_segment->base;
+    if (find_segment->state == SEG_BLOCK && BLOCK_OF(base)->refs > 1) {
+        base = unshare_segment(memory, segment_index, BLOCK_OF(base))->words;
+    }
+
+    base[word_index] = word;
+
+    if (segment_index == 0) {
+        mark_seg0_dirty(memory, word_index);
+    }
+}
+
+/*
+* writable_range
+* Purpose: To check a range of a segment for a bulk store and get a 
+*          pointer through which it may be written
+* Parameters: struct Memory *memory - the memory manager
+*             uint32_t segment_index - a mapped segment
+*             uint32_t first, count - the range, which must lie inside it
+* Returns: the segment's words, unshared from any load program copy
+* Notes: an unmapped segment or a range past its end fails, as a store to 
+*        either would
+*/
+static uint32_t *writable_range(struct Memory *memory, 
+                                uint32_t segment_index, uint32_t first, 
+                                uint32_t count)
+{
+    struct Descriptor *find_segment = memory_lookup(memory, segment_index);
+
     /*failure mode if out of bounds*/
-    Seq_T find_segment = Seq_get(memory->segments, segment_index);
+    assert((uint64_t)first + count <= find_segment->length);
 
-    assert(find_segment != NULL);/*Failure mode if refer to unmapped*/ 
+    if (descriptor_shared(find_segment)) {
+        return unshare_segment(memory, segment_index, 
+                               BLOCK_OF(find_segment->base))->words;
+    }
+    return find_segment->base;
+}
 
-    uint32_t *word_ptr = malloc(sizeof(uint32_t));
-    assert(word_ptr != NULL);
-    *word_ptr = word;
+/*
+* mark_seg0_range
+* Purpose: To mark every word of a bulk store into segment 0 dirty
+* Parameters: struct Memory *memory - the memory manager
+*             uint32_t first, count - the words stored into, in bounds
+* Returns: nothing
+*/
+static void mark_seg0_range(struct Memory *memory, uint32_t first, 
+                            uint32_t count)
+{
+    for (uint32_t k = 0; k < count; k++) {
+        mark_seg0_dirty(memory, first + k);
+    }
+}
+
+/*
+* copy_words
+* Purpose: To copy a block of words from one segment to another, or within 
+*          one segment, as the BCOPY extension instruction does
+* Parameters: struct Memory *memory - the memory manager
+*             uint32_t to_segment, to_word - where the block goes
+*             uint32_t from_segment, from_word - where it comes from
+*             uint32_t count - its number of words
+* Returns: nothing
+* Notes: the result is that of memmove, so the two ranges may overlap. 
+*        Both segments must be mapped and both ranges in bounds, even when 
+*        count is 0. Words copied into segment 0 are marked dirty.
+*/
+void copy_words(struct Memory *memory, uint32_t to_segment, 
+                uint32_t to_word, uint32_t from_segment, 
+                uint32_t from_word, uint32_t count)
+{
+    assert(memory != NULL);
+
+    struct Descriptor *from = memory_lookup(memory, from_segment);
+
+    /*failure mode if out of bounds*/
+    assert((uint64_t)from_word + count <= from->length);
+
+    uint32_t *to = writable_range(memory, to_segment, to_word, count);
+
+    /*from->base is read only now: when source and destination are one 
+      segment, unsharing it moved its words*/
+    memmove(to + to_word, from->base + from_word, 
+            (size_t)count * sizeof(uint32_t));
+
+    if (to_segment == 0) {
+        mark_seg0_range(memory, to_word, count);
+    }
+}
+
+/*
+* fill_words
+* Purpose: To set a block of words of a segment to one value, as the FILL 
+*          extension instruction does
+* Parameters: struct Memory *memory - the memory manager
+*             uint32_t segment_index, first - where the block starts
+*             uint32_t count - its number of words
+*             uint32_t word - the value to store in each
+* Returns: nothing
+* Notes: the segment must be mapped and the range in bounds, even when 
+*        count is 0. Words filled in segment 0 are marked dirty.
+*/
+void fill_words(struct Memory *memory, uint32_t segment_index, 
+                uint32_t first, uint32_t count, uint32_t word)
+{
+    assert(memory != NULL);
+
+    uint32_t *words = writable_range(memory, segment_index, first, count);
+
+    if (word == 0) {
+        memset(words + first, 0, (size_t)count * sizeof(uint32_t));
+    }
+    else {
+        for (uint32_t k = 0; k < count; k++) {
+            words[first + k] = word;
+        }
+    }
+
+    if (segment_index == 0) {
+        mark_seg0_range(memory, first, count);
+    }
+}
+
+/*
+* read_range
+* Purpose: To check a range of a segment for a bulk load and get a 
+*          pointer to its first word
+* Parameters: struct Memory *memory - the memory manager
+*             uint32_t segment_index - a mapped segment
+*             uint32_t first, count - the range, which must lie inside it
+* Returns: a pointer to m[segment_index][first]
+* Notes: the pointer is only good until the next store, map or unmap. An 
+*        unmapped segment or a range past its end fails, as a load from 
+*        either would, even when count is 0.
+*/
+const uint32_t *read_range(struct Memory *memory, uint32_t segment_index, 
+                           uint32_t first, uint32_t count)
+{
+    assert(memory != NULL);
+
+    struct Descriptor *find_segment = memory_lookup(memory, segment_index);
 
     /*failure mode if out of bounds*/
-    uint32_t *old_word_ptr = Seq_put(find_segment, word_index, word_ptr);
-    free(old_word_ptr);
+    assert((uint64_t)first + count <= find_segment->length);
+
+    return find_segment->base + first;
+}
+
+/*
+* store_words
+* Purpose: To store an array of words into a block of a segment, as the 
+*          bulk input extension instruction does
+* Parameters: struct Memory *memory - the memory manager
+*             uint32_t segment_index, first - where the block starts
+*             uint32_t count - its number of words
+*             const uint32_t *words - the values, outside the segment
+* Returns: nothing
+* Notes: the segment must be mapped and the range in bounds. Words stored 
+*        into segment 0 are marked dirty.
+*/
+void store_words(struct Memory *memory, uint32_t segment_index, 
+                 uint32_t first, uint32_t count, const uint32_t *words)
+{
+    assert(memory != NULL && (words != NULL || count == 0));
+
+    uint32_t *to = writable_range(memory, segment_index, first, count);
+
+    memcpy(to + first, words, (size_t)count * sizeof(uint32_t));
+
+    if (segment_index == 0) {
+        mark_seg0_range(memory, first, count);
+    }
+}
+
+/*
+* grow_table
+* Purpose: To double the capacity of the descriptor table, keeping it 
+*          aligned to a cache line and the base pointers of inline 
+*          segments pointing into it
+* Parameters: struct Memory *memory - the memory manager
+* Returns: nothing
+* Notes: fails the program cleanly if the new entries would take it past 
+*        its quota or cannot be allocated; asserts if every segment ID 
+*        that fits in a register is already in use
+*/
+static void grow_table(struct Memory *memory)
+{
+    assert(memory->table_capacity < NO_SEGMENT / 2);
+
+    uint32_t capacity = memory->table_capacity * 2;
+    uint64_t added = (uint64_t)(capacity - memory->table_capacity) * 
+                     (sizeof(struct Descriptor) / sizeof(uint32_t));
+    struct Descriptor *table;
+
+    check_quota(memory, added);
+    if (posix_memalign((void **)&table, CACHE_LINE, 
+                       (size_t)capacity * sizeof(struct Descriptor)) != 0) {
+        out_of_memory("the segment table");
+    }
+    memory->table_words += added;
+
+    memcpy(table, memory->core.table, 
+           (size_t)memory->core.table_length * sizeof(struct Descriptor));
+    free(memory->core.table);
+
+    /*inline segments must follow their descriptors to the new table*/
+    for (uint32_t i = 0; i < memory->core.table_length; i++) {
+        if (table[i].base != NULL && table[i].state == SEG_INLINE) {
+            table[i].base = table[i].inline_words;
+        }
+    }
+
+    memory->stats.reserved_bytes += (uint64_t)(capacity - 
+                                    memory->table_capacity) * 
+                                    sizeof(struct Descriptor);
+    memory->core.table = table;
+    memory->table_capacity = capacity;
+    memory->core.last_id = NO_SEGMENT;
+    memory->core.last = &no_descriptor;
 }
 
 /*
@@ -214,10 +1116,9 @@ void set_word(struct Memory *memory, uint32_t segment_index,
 * Purpose: To create a new segment within the memory manager that will
 *          contain a size that is indicated in the parameter, where 
 *          "num_words"-many words all initialized to 0 will be stored. This
-*          function will either recycle the oldest segment that has been 
-*          unmapped, or append a brand new segment onto the end of the 
-*          Sequence of memory segments, only if there are no unmapped
-*          segments to re-use. 
+*          function will either recycle the most recently unmapped 
+*          segment ID, or append a brand new descriptor onto the end of 
+*          the segment table, only if there are no unmapped IDs to re-use. 
 * Input: struct Memory *memory - a struct pointer to an instance of 
 *                   an initalized memory manager. 
 *        uint32_t num_words - an integer indiating the size of the newly 
@@ -231,32 +1132,35 @@ void set_word(struct Memory *memory, uint32_t segment_index,
 uint32_t map_segment(struct Memory *memory, uint32_t num_words)
 {
     assert(memory != NULL);
-    assert(memory->segments != NULL);
-    assert(memory->map_queue != NULL);
+    assert(memory->core.table != NULL);
 
-    Seq_T new_segment = Seq_new(num_words);
-    /*Initialize*/
-    for (uint32_t i = 0; i < num_words; i++) {
-        uint32_t *word_ptr = malloc(sizeof(uint32_t));
-        assert(word_ptr != NULL);
-
-        *word_ptr = 0;
-        Seq_addhi(new_segment, word_ptr);
+    /*fail cleanly, before anything is allocated, if over quota*/
+    charge(memory, num_words);
+    if (++memory->stats.live_segments > memory->stats.peak_segments) {
+        memory->stats.peak_segments = memory->stats.live_segments;
     }
 
-    if (Seq_length(memory->map_queue) != 0) {
-        uint32_t *seq_index = (uint32_t *)Seq_remlo(memory->map_queue);
-        Seq_put(memory->segments, *seq_index, new_segment);
-        
-        uint32_t segment_index = *seq_index;
-        free(seq_index);
-        return segment_index;
+    uint32_t segment_index;
+
+    if (memory->free_head != NO_SEGMENT) {
+        segment_index = memory->free_head;
+        memory->free_head = memory->core.table[segment_index].state;
     }
     else {
-        uint32_t length = (uint32_t)Seq_length(memory->segments);
-        Seq_addhi(memory->segments, new_segment);
-        return length;
+        if (memory->core.table_length == memory->table_capacity) {
+            grow_table(memory);
+        }
+        segment_index = memory->core.table_length++;
     }
+
+    /*Initialize all words to 0, in the descriptor or in a single block*/
+    if (num_words <= INLINE_WORDS) {
+        install_inline(memory, segment_index, num_words, NULL);
+    } else {
+        install_segment(memory, segment_index, 
+                        new_segment(memory, num_words, num_words));
+    }
+    return segment_index;
 }
 
 
@@ -266,8 +1170,8 @@ uint32_t map_segment(struct Memory *memory, uint32_t num_words)
 *          segments. In other words, the uint32_t words that were previously 
 *          were contained in this segment could no longer be accessed once 
 *          that segment is unmapped. This function ensures that the 
-*          index of the unmapped segment gets stored onto a queue 
-*          for purposes of recycling when the caller decides to map
+*          index of the unmapped segment gets pushed onto the free-ID 
+*          stack for purposes of recycling when the caller decides to map
 *          a brand new segment
 * Input: struct Memory *memory - a struct pointer to an instance of 
 *                   an initalized memory manager. 
@@ -280,27 +1184,27 @@ uint32_t map_segment(struct Memory *memory, uint32_t num_words)
 void unmap_segment(struct Memory *memory, uint32_t segment_index)
 {
     assert(memory != NULL);
-    assert(memory->segments != NULL);
-    assert(memory->map_queue != NULL);
+    assert(memory->core.table != NULL);
     /* can't un-map segment 0 */
     assert(segment_index > 0);
+    assert(segment_index < memory->core.table_length);
 
-    Seq_T seg_to_unmap = (Seq_T)(Seq_get(memory->segments, segment_index));
+    struct Descriptor *descriptor = &memory->core.table[segment_index];
     /* can't un-map a segment that isn't mapped */
-    assert(seg_to_unmap != NULL);
+    assert(descriptor->base != NULL);
 
-    for (int j = 0; j < Seq_length(seg_to_unmap); j++) {
-        uint32_t *word = (uint32_t *)(Seq_get(seg_to_unmap, j));
-        free(word);
+    /*segment 0 may still be running out of this block*/
+    if (descriptor->state == SEG_BLOCK) {
+        drop_segment(memory, BLOCK_OF(descriptor->base));
+    } else {
+        memory->stats.live_words -= descriptor->length;
     }
+    memory->stats.live_segments--;
 
-    Seq_free(&seg_to_unmap);
-
-    Seq_put(memory->segments, segment_index, NULL);
-
-    uint32_t *num = malloc(sizeof(uint32_t));
-    *num = segment_index;
-    Seq_addhi(memory->map_queue, num);
+    descriptor->base = NULL;
+    descriptor->length = 0;
+    descriptor->state = memory->free_head;
+    memory->free_head = segment_index;
 }
 
 
@@ -311,7 +1215,10 @@ void unmap_segment(struct Memory *memory, uint32_t segment_index)
 *          manager. This function will identify which segment is to be 
 *          duplicated to replace segment 0.It also ensures that if the 
 *          indicated segment to duplicate is segment 0 itself, that it 
-*          will not spend extra time deep-copying word instructions
+*          will not spend extra time deep-copying word instructions.
+*          The duplicate is copy-on-write: segment 0 shares the block of 
+*          the loaded segment, and the copy is only made if set_word 
+*          later writes through either index.
 * Input: struct Memory *memory - a struct pointer to an instance of 
 *                   an initalized memory manager. 
 *        uint32_t segment_index - an integer indiating the desired segment 
@@ -323,46 +1230,177 @@ void unmap_segment(struct Memory *memory, uint32_t segment_index)
 void duplicate_segment(struct Memory *memory, uint32_t segment_to_copy)
 {
     assert(memory != NULL);
-    assert(memory->segments != NULL);
-    assert(memory->map_queue != NULL);
+    assert(memory->core.table != NULL);
 
     if (segment_to_copy != 0) {
 
-        Seq_T seg_0 = (Seq_T)(Seq_get(memory->segments, 0));
+        assert(segment_to_copy < memory->core.table_length);
+        struct Descriptor *source = &memory->core.table[segment_to_copy];
+        /*Check if copy index has been unmapped*/
+        assert(source->base != NULL); 
 
-        /*free all words in segment 0*/
-        for (int j = 0; j < Seq_length(seg_0); j++) {
-            uint32_t *word = (uint32_t *)(Seq_get(seg_0, j));
-            free(word);
+        /*claim the source before dropping segment 0: they may be shared*/
+        if (source->state == SEG_BLOCK) {
+            BLOCK_OF(source->base)->refs++;
+        }
+        if (memory->core.table[0].state == SEG_BLOCK) {
+            drop_segment(memory, BLOCK_OF(memory->core.table[0].base));
+        } else {
+            memory->stats.live_words -= memory->core.table[0].length;
         }
 
-        /*Free memory of old segment0*/
-        Seq_free(&seg_0);
+        if (source->state == SEG_INLINE) {
+            /*an inline segment is cheaper to copy than to share*/
+            charge(memory, source->length);
+            install_inline(memory, 0, source->length, source->inline_words);
+        } else {
+            /*lazy copy - share the segment's block as the new segment 0*/
+            install_segment(memory, 0, BLOCK_OF(source->base));
+        }
+        memory->seg0_generation++;
+        clear_seg0_dirty(memory);
 
-        /*hard copy - duplicate segment to create new segment 0*/
-        Seq_T target = (Seq_T)Seq_get(memory->segments, segment_to_copy);
-        assert(target != NULL); /*Check if copy index has been unmapped*/
+    } else {
+        /*don't replace segment0 with itself --- do nothing*/
+        return;
+    }
+}
 
-        uint32_t seg_length = Seq_length(target);
+/*
+* segment_words
+* Purpose: To give read-only access to the words of a mapped segment, for 
+*          callers that scan a whole segment at once
+* Input: struct Memory *memory - a struct pointer to an instance of 
+*                   an initalized memory manager
+*        uint32_t segment_index - a mapped segment
+* Expected Output: a pointer to the segment's first word. It stays valid 
+*                  only until the next map, unmap, load program or store.
+* Note: it is a checked runtime error for segment_index to be unmapped
+*/
+const uint32_t *segment_words(struct Memory *memory, uint32_t segment_index)
+{
+    assert(memory != NULL);
 
-        Seq_T duplicate = Seq_new(30);
+    return memory_lookup(memory, segment_index)->base;
+}
 
-        /*Willl copy every single word onto the duplicate segment*/
-        for (uint32_t i = 0; i < seg_length; i++) {
-            uint32_t *dup_word = malloc(sizeof(uint32_t));
-            uint32_t *word = Seq_get(target, i);
-            *dup_word = *word;
-            
-            Seq_addhi(duplicate, dup_word);
-        }
+/*
+* seg0_generation
+* Purpose: To let a cache of decoded instructions tell whether segment 0 
+*          is still the program it decoded
+* Input: struct Memory *memory - a struct pointer to an instance of 
+*                   an initalized memory manager
+* Expected Output: a counter that changes whenever load program replaces 
+*                  segment 0 or the loader appends to it. Stores into 
+*                  segment 0 do not change it; they are reported by 
+*                  seg0_clean instead.
+* Note: memory must not be NULL
+*/
+uint64_t seg0_generation(struct Memory *memory)
+{
+    assert(memory != NULL);
 
-        /*replace segment0 with the duplicate*/
-        Seq_put(memory->segments, 0, duplicate);
+    return memory->seg0_generation;
+}
 
-    } else {
-        /*don't replace segment0 with itself --- do nothing*/
+/*
+* seg0_clean
+* Purpose: To visit, in increasing order, every word of segment 0 written 
+*          by set_word since the last call (or since segment 0 was last 
+*          replaced), and then forget them
+* Input: struct Memory *memory - a struct pointer to an instance of 
+*                   an initalized memory manager
+*        apply - called with the index of each dirty word and cl
+*        void *cl - closure passed through to apply
+* Expected Output: none
+* Note: memory must not be NULL. Cost is proportional to the span between 
+*       the lowest and highest dirty words, not to the segment's length.
+*/
+void seg0_clean(struct Memory *memory, 
+                void apply(uint32_t word_index, void *cl), void *cl)
+{
+    assert(memory != NULL);
+    assert(apply != NULL);
+
+    if (memory->dirty_lo > memory->dirty_hi) {
         return;
     }
+    for (uint32_t w = memory->dirty_lo / 64; w <= memory->dirty_hi / 64; 
+         w++) {
+        uint64_t bits = memory->seg0_dirty[w];
+        while (bits != 0) {
+            uint32_t bit = (uint32_t)__builtin_ctzll(bits);
+            bits &= bits - 1;
+            apply(w * 64 + bit, cl);
+        }
+    }
+    clear_seg0_dirty(memory);
+}
+
+/*
+* memory_use_hugepages
+* Purpose: To switch huge-page mode on or off. In huge-page mode segment 0
+*          and every segment of at least HUGE_THRESHOLD_WORDS words live in 
+*          2 MB aligned regions advised with MADV_HUGEPAGE, cutting TLB 
+*          misses on large programs and data. Unmapped huge regions give 
+*          their pages back with MADV_DONTNEED so peak RSS is not kept.
+* Input: struct Memory *memory - a struct pointer to an instance of 
+*                   an initalized memory manager
+*        bool enable - whether to turn huge-page mode on
+* Expected Output: none
+* Note: must be called before segment 0 is populated to affect it. A 
+*       huge region is backed by whole 2 MB pages once touched, so very 
+*       sparse segments use more memory in this mode.
+*/
+void memory_use_hugepages(struct Memory *memory, bool enable)
+{
+    assert(memory != NULL);
+
+    memory->hugepages = enable;
+}
+
+/*
+* memory_set_quota
+* Purpose: To limit how many words the UM program may have live at once, 
+*          across all of its segments. A map, load program or store that 
+*          would need more fails the program with a message on stderr.
+* Input: struct Memory *memory - a struct pointer to an instance of 
+*                   an initalized memory manager
+*        uint64_t quota_words - the limit, or 0 for no limit
+* Expected Output: none
+* Note: memory must not be NULL. Segment 0 counts against the quota, and 
+*       a block shared after load program counts once until it is copied. 
+*       So does the descriptor table, 16 words a segment, once it grows 
+*       past its first TABLE_HINT entries.
+*/
+void memory_set_quota(struct Memory *memory, uint64_t quota_words)
+{
+    assert(memory != NULL);
+
+    memory->quota_words = quota_words;
+}
+
+/*
+* memory_stats
+* Purpose: To report the footprint of the UM address space along with 
+*          the counters kept by the segment pool, so that a driver can 
+*          print them and the size classes can be sized against real 
+*          workloads
+* Input: struct Memory *memory - a struct pointer to an instance of 
+*                   an initalized memory manager
+* Expected Output: a copy of the current Memory_stats
+* Note: memory must not be NULL
+*/
+Memory_stats memory_stats(struct Memory *memory)
+{
+    assert(memory != NULL);
+
+    Memory_stats stats = memory->stats;
+    uint64_t live_bytes = stats.live_words * sizeof(uint32_t);
+
+    stats.overhead_bytes = stats.reserved_bytes > live_bytes ? 
+                           stats.reserved_bytes - live_bytes : 0;
+    return stats;
 }
 
 /*
@@ -376,43 +1414,27 @@ void duplicate_segment(struct Memory *memory, uint32_t segment_to_copy)
 *                   an initalized memory manager containing all the 
 *                   references to dynamically allocated memory
 * Expected Output: none
-* Note: 
+* Note: Every segment block lives in the region, so this releases the 
+*       chunks of the region and never visits individual segments or words
 */
 void free_segments(struct Memory *memory)
 {
     assert(memory != NULL);
 
 
-    uint32_t num_sequences = Seq_length(memory->segments);
-    /*Free all words in each segment of memory*/
-    for (uint32_t i = 0; i < num_sequences; i++)
-    {
-        Seq_T find_segment = (Seq_T)(Seq_get(memory->segments, i));
-    
-        /*Only free words in segments that are non-null*/
-        if (find_segment != NULL) {
-            uint32_t seg_length = Seq_length(find_segment);
-
-            for (uint32_t j = 0; j < seg_length; j++) {
-                // printf("    processing %d\n", j);
-                uint32_t *word = (uint32_t *)(Seq_get(find_segment, j));
-                free(word);
-            }
-            Seq_free(&find_segment);
+    /*Release the region, which holds the blocks of every segment*/
+    struct Chunk *lists[2] = { memory->chunks, memory->spares };
+    for (int i = 0; i < 2; i++) {
+        struct Chunk *chunk = lists[i];
+        while (chunk != NULL) {
+            struct Chunk *next = chunk->next;
+            free_chunk(chunk);
+            chunk = next;
         }
     }
 
-    /* free map_queue Sequence that kept track of unmapped stuff*/
-    uint32_t queue_length = Seq_length(memory->map_queue);
-    
-    /*free all the indexes words */
-    for (uint32_t i = 0; i < queue_length; i++) {
-        uint32_t *index = (uint32_t*)(Seq_get(memory->map_queue, i));
-        free(index);
-    }
-
-    Seq_free(&(memory->segments));
-    Seq_free(&(memory->map_queue));
+    free(memory->core.table);
+    free(memory->seg0_dirty);
     
     free(memory);
 }
\ No newline at end of file
@@ -19,6 +19,9 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <assert.h>
 
 #ifndef MEMORY_MANAGER_H
 #define MEMORY_MANAGER_H
@@ -26,6 +29,227 @@
 /*A struct pointer to create a hidden instance of the Memory manager*/
 typedef struct Memory *Memory;
 
+/*Number of size classes in the segment pool, indexed by log2 of the block
+  size in words (the largest pooled block holds 2^16 words)*/
+#define NUM_SIZE_CLASSES 17
+
+/*
+* struct Pool_stats
+* Purpose: Counters kept by the segment pool so its size classes can be 
+*          tuned against real workloads
+* Members: uint64_t hits[] - per size class, how many blocks were reused 
+*                   from the free list instead of being allocated
+*          uint64_t misses[] - per size class, how many blocks had to be 
+*                   carved out of the region
+*          uint64_t sparse_maps - how many segments were too large for any
+*                   size class and got a dedicated demand-zero mapping
+*          uint64_t huge_maps - how many of those mappings were placed in 
+*                   transparent huge pages
+*          uint64_t spare_reuses - how many times an emptied huge region 
+*                   was reused instead of mapping a new one
+*          uint64_t bytes_retained - bytes currently held on free lists
+* Notes: classes below the smallest pooled size always read 0
+*/
+typedef struct Pool_stats {
+    uint64_t hits[NUM_SIZE_CLASSES];
+    uint64_t misses[NUM_SIZE_CLASSES];
+    uint64_t sparse_maps;
+    uint64_t huge_maps;
+    uint64_t spare_reuses;
+    uint64_t bytes_retained;
+} Pool_stats;
+
+/*
+* struct Memory_stats
+* Purpose: The footprint of the UM address space, for drivers to report 
+*          and for quotas to be chosen against
+* Members: uint64_t live_words, peak_words - words held by mapped segments 
+*                   now and at most so far (a block shared by load program
+*                   counts once)
+*          uint32_t live_segments, peak_segments - mapped segments now and 
+*                   at most so far, segment 0 included
+*          uint64_t reserved_bytes - bytes the allocator currently holds: 
+*                   region chunks, mapped segments and the descriptor table
+*          uint64_t overhead_bytes - reserved_bytes not holding live words
+*          Pool_stats pool - the segment pool's counters
+* Notes: mapped segments count their full size even if most of their 
+*        pages were never touched
+*/
+typedef struct Memory_stats {
+    uint64_t live_words;
+    uint64_t peak_words;
+    uint32_t live_segments;
+    uint32_t peak_segments;
+    uint64_t reserved_bytes;
+    uint64_t overhead_bytes;
+    Pool_stats pool;
+} Memory_stats;
+
+/*
+* The layout below is shared with memory_manager.c only so that get_word 
+* and set_word can be inlined into the execution loop. Clients must still 
+* go through the functions; nothing outside memory_manager.c writes it.
+*/
+
+#define CACHE_LINE 64
+/*Segments this short live inside their descriptor: one cache line total*/
+#define INLINE_WORDS ((CACHE_LINE - 16) / sizeof(uint32_t))
+/*Values of a mapped descriptor's state*/
+#define SEG_BLOCK 0
+#define SEG_INLINE 1
+
+/*
+* struct Segment
+* Purpose: To hold every word of a single memory segment in one contiguous, 
+*          length-prefixed block so that a segment costs a single allocation
+*          no matter how many words it contains.
+* Members: uint32_t length - the number of words the UM program can access
+*          uint32_t capacity - the number of words allocated after the 
+*                   header. For pooled blocks this is the power of two of 
+*                   the block's size class, larger blocks are exact-fit
+*          uint32_t refs - how many segment indices currently share this 
+*                   block. Load program makes segment 0 share the block of 
+*                   the segment it loads, and the first set_word through 
+*                   either index gives that index a private copy.
+*          uint32_t mapped - 1 if the block is the only thing in a 
+*                   dedicated mapped chunk, 0 if it belongs to the pool
+*          uint32_t words[] - the words themselves, laid out back to back
+* Notes: words are stored by value, so loads and stores are plain array 
+*        accesses with a bounds check against length. While a pooled block 
+*        sits on a free list, its first words hold the next-block link
+*/
+struct Segment
+{
+    uint32_t length;
+    uint32_t capacity;
+    uint32_t refs;
+    uint32_t mapped; /*also keeps words[] 8-byte aligned for free links*/
+    uint32_t words[];
+};
+
+/*
+* struct Descriptor
+* Purpose: One entry of the flat segment table: everything needed to reach 
+*          a word of a mapped segment with a single load, exactly one cache
+*          line long. Segments of at most INLINE_WORDS words (cons cells, 
+*          small records) are stored in the descriptor itself and need no 
+*          block at all, so touching one touches a single line.
+* Members: uint32_t *base - the first word of the segment: either 
+*                   inline_words or the words of its block, or NULL when 
+*                   the segment is unmapped
+*          uint32_t length - the number of words in the segment
+*          uint32_t state - while mapped, SEG_INLINE or SEG_BLOCK; while 
+*                   unmapped, the index of the next unmapped segment on 
+*                   the free-ID stack
+*          uint32_t inline_words[] - the words of an inline segment
+* Notes: base of an inline segment points into the table, so it moves 
+*        whenever the table grows
+*/
+struct Descriptor
+{
+    uint32_t *base;
+    uint32_t length;
+    uint32_t state;
+    uint32_t inline_words[INLINE_WORDS];
+};
+
+/*Fails to compile if a descriptor stops being exactly one cache line*/
+typedef char descriptor_is_one_line[sizeof(struct Descriptor) == CACHE_LINE 
+                                    ? 1 : -1];
+
+/*Recovers the block header from a descriptor's base pointer*/
+#define BLOCK_OF(base) \
+        ((struct Segment *)((char *)(base) - offsetof(struct Segment, words)))
+
+/*
+* struct Memory_core
+* Purpose: The first member of struct Memory: the part of the memory 
+*          manager that loads and stores read
+* Members: struct Descriptor *table - the cache-line aligned table of 
+*                   segment descriptors, indexed by segment ID
+*          uint32_t table_length - the number of IDs ever handed out, 
+*                   including ones that are currently unmapped
+*          uint32_t last_id, struct Descriptor *last - a one-entry 
+*                   lookaside remembering the most recently used 
+*                   descriptor, so runs of loads and stores to one segment
+*                   skip the table index and bounds check; when empty,
+*                   last_id is UINT32_MAX and last a descriptor that is
+*                   never mapped
+* Notes: a Memory points at its core, so the inline functions reach it 
+*        with a cast and the rest of struct Memory stays hidden
+*/
+struct Memory_core
+{
+    struct Descriptor *table;
+    uint32_t table_length;
+    uint32_t last_id;
+    struct Descriptor *last;
+};
+
+/*
+* memory_lookup
+* Purpose: To find the descriptor of a mapped segment, answering from the
+*          lookaside when the same segment was used last
+* Input: an instance of the memory manager and the ID to look up
+* Expected Output: a pointer to the segment's descriptor, valid until the 
+*                  table next grows
+* Note: Fails if the ID was never handed out or is currently unmapped
+*/
+static inline struct Descriptor *memory_lookup(Memory memory, 
+                                               uint32_t segment_index)
+{
+    struct Memory_core *core = (struct Memory_core *)memory;
+
+    if (segment_index != core->last_id) {
+        /*failure mode if out of bounds*/
+        assert(segment_index < core->table_length);
+
+        core->last = &core->table[segment_index];
+        core->last_id = segment_index;
+    }
+
+    /*Failure mode if refer to unmapped*/
+    assert(core->last->base != NULL);
+
+    return core->last;
+}
+
+/*
+* memory_find
+* Purpose: To find the descriptor of a segment without failing, for 
+*          callers that check their own preconditions
+* Input: an instance of the memory manager and any segment ID
+* Expected Output: the segment's descriptor, or NULL if the ID is not 
+*                  mapped
+* Note: does not touch the lookaside
+*/
+static inline struct Descriptor *memory_find(Memory memory, 
+                                             uint32_t segment_index)
+{
+    struct Memory_core *core = (struct Memory_core *)memory;
+
+    if (segment_index >= core->table_length || 
+        core->table[segment_index].base == NULL) {
+        return NULL;
+    }
+    return &core->table[segment_index];
+}
+
+/*
+* descriptor_shared
+* Purpose: To tell whether a mapped segment still shares its block with 
+*          another ID after load program, so a store must go through 
+*          set_word to get a private copy first
+* Input: a mapped segment's descriptor
+* Expected Output: true if the block is shared
+* Note: inline segments are never shared
+*/
+static inline bool descriptor_shared(const struct Descriptor *descriptor)
+{
+    return descriptor->state == SEG_BLOCK && 
+           BLOCK_OF(descriptor->base)->refs > 1;
+}
+
 /*
 * initialize_memory
 * Purpose: To create an instance of a Memory_manager struct that will 
@@ -65,17 +289,38 @@ uint32_t segmentlength(Memory memory, uint32_t segment_index);
 /*
 * add_to_seg0
 * Purpose: To populate the 0th segment that will contain the UM program
-* Input: an intance of the memory manager and a reference to a 
-*        single uint32_t word 
+* Input: an intance of the memory manager and a single uint32_t word 
 *        instruction
 * Expected Output: none
 * Note: This function populates the 0th segment one word at a time, and 
 *       should be called iteratively.
-*       memory and word cannot be NULL
+*       memory cannot be NULL
 */
-void add_to_seg0(Memory memory, uint32_t *word);
+void add_to_seg0(Memory memory, uint32_t word);
 
 
+/*
+* load_seg0
+* Purpose: To populate the 0th segment with a whole program in one copy
+* Input: an instance of the memory manager, the program's words in host 
+*        order and their number
+* Expected Output: none
+* Note: segment 0 must still be empty. memory cannot be NULL
+*/
+void load_seg0(Memory memory, const uint32_t *words, uint32_t length);
+
+
+/*
+* set_word_slow
+* Purpose: The out-of-line part of set_word: stores into segment 0 or into 
+*          a block still shared after load program
+* Input: as for set_word, already bounds checked
+* Expected Output: none
+* Note: only set_word should call this
+*/
+void set_word_slow(Memory memory, uint32_t segment_index, 
+                   uint32_t word_index, uint32_t word);
+
 /*
 * get_word
 * Purpose: To retrieve a word form a desired segment in memory
@@ -86,8 +331,18 @@ void add_to_seg0(Memory memory, uint32_t *word);
 * Note: memory cannot be NULL, segment index and word in segmnet must be 
 *       in bounds
 */
-uint32_t get_word(Memory memory, uint32_t segment_index, 
-                  uint32_t word_in_segment);
+static inline uint32_t get_word(Memory memory, uint32_t segment_index, 
+                                uint32_t word_in_segment)
+{
+    assert(memory != NULL);
+
+    struct Descriptor *find_segment = memory_lookup(memory, segment_index);
+
+    /*failure mode if out of bounds*/
+    assert(word_in_segment < find_segment->length);
+
+    return find_segment->base[word_in_segment];
+}
 
 /*
 * set_word
@@ -99,12 +354,79 @@ uint32_t get_word(Memory memory, uint32_t segment_index,
 *        at that index
 * Expected Output: none
 * Note: memory must not be NULL, segment_index and word_index must be in 
-*       bounds 
+*       bounds. A store into segment 0 or into a block shared by load 
+*       program is finished by set_word_slow.
 */
-void set_word(Memory memory, uint32_t segment_index, uint32_t word_index, 
-              uint32_t word);
+static inline void set_word(Memory memory, uint32_t segment_index, 
+                            uint32_t word_index, uint32_t word)
+{
+    assert(memory != NULL);
+
+    struct Descriptor *find_segment = memory_lookup(memory, segment_index);
+
+    /*failure mode if out of bounds*/
+    assert(word_index < find_segment->length);
+
+    if (segment_index == 0 || descriptor_shared(find_segment)) {
+        set_word_slow(memory, segment_index, word_index, word);
+        return;
+    }
+    find_segment->base[word_index] = word;
+}
 
 
+/*
+* copy_words
+* Purpose: To copy count words from m[from_segment] starting at from_word 
+*          to m[to_segment] starting at to_word
+* Input: an instance of the memory manager, the destination, the source 
+*        and the number of words
+* Expected Output: none
+* Note: behaves like memmove, so the ranges may overlap. Both segments 
+*       must be mapped and both ranges in bounds; memory cannot be NULL
+*/
+void copy_words(Memory memory, uint32_t to_segment, uint32_t to_word, 
+                uint32_t from_segment, uint32_t from_word, uint32_t count);
+
+
+/*
+* fill_words
+* Purpose: To store word into count words of m[segment_index] starting at 
+*          first
+* Input: an instance of the memory manager, the block and the value
+* Expected Output: none
+* Note: the segment must be mapped and the range in bounds; memory cannot 
+*       be NULL
+*/
+void fill_words(Memory memory, uint32_t segment_index, uint32_t first, 
+                uint32_t count, uint32_t word);
+
+
+/*
+* read_range
+* Purpose: To get m[segment_index][first] on for a bulk load of count words
+* Input: an instance of the memory manager and the block
+* Expected Output: a read-only pointer to the block's first word, good 
+*                  until memory next changes
+* Note: the segment must be mapped and the range in bounds; memory cannot 
+*       be NULL
+*/
+const uint32_t *read_range(Memory memory, uint32_t segment_index, 
+                           uint32_t first, uint32_t count);
+
+
+/*
+* store_words
+* Purpose: To store count words from an array into m[segment_index] 
+*          starting at first
+* Input: an instance of the memory manager, the block and the values
+* Expected Output: none
+* Note: the segment must be mapped and the range in bounds; memory cannot 
+*       be NULL
+*/
+void store_words(Memory memory, uint32_t segment_index, uint32_t first, 
+                 uint32_t count, const uint32_t *words);
+
 /*
 * map_segment
 * Purpose: To create a new segment within the memory manager
@@ -112,7 +434,8 @@ void set_word(Memory memory, uint32_t segment_index, uint32_t word_index,
 *        desired number of words that the new segment will hold
 * Expected Output: none
 * Note: memory must not be NULL and num_words must be positive and less than 
-*       2^32
+*       2^32. Segments too large for the pool are backed by demand-zero 
+*       pages, so mapping one takes the same time whatever its size.
 */
 uint32_t map_segment(Memory memory, uint32_t num_words);
 
@@ -143,13 +466,85 @@ void unmap_segment(Memory memory, uint32_t segment_index);
 void duplicate_segment(Memory memory, uint32_t segment_to_copy);
 
 
+/*
+* memory_use_hugepages
+* Purpose: To place segment 0 and large segments in 2 MB transparent 
+*          huge pages, returning the pages of large unmapped segments to 
+*          the kernel
+* Input: an instance of the memory manager and whether to enable the mode
+* Expected Output: none
+* Note: memory must not be NULL; call before segment 0 is populated
+*/
+void memory_use_hugepages(Memory memory, bool enable);
+
+
+/*
+* memory_set_quota
+* Purpose: To cap the number of words the UM program may have live at once;
+*          going past it fails the program cleanly instead of exhausting 
+*          the host
+* Input: an instance of the memory manager and the quota in words (0 means 
+*        no limit)
+* Expected Output: none
+* Note: memory must not be NULL. Descriptors count too, once the table 
+*       grows, so many empty segments are limited like large ones.
+*/
+void memory_set_quota(Memory memory, uint64_t quota_words);
+
+
+/*
+* memory_stats
+* Purpose: To report the footprint accounting and pool counters
+* Input: an instance of the memory manager
+* Expected Output: a copy of the current Memory_stats
+* Note: memory must not be NULL
+*/
+Memory_stats memory_stats(Memory memory);
+
+
+/*
+* segment_words
+* Purpose: To read a whole mapped segment without a call per word
+* Input: an instance of the memory manager and a mapped segment index
+* Expected Output: a pointer to the segment's words, valid until the next 
+*                  map, unmap, load program or store
+* Note: the index must be mapped, and memory cannot be NULL
+*/
+const uint32_t *segment_words(Memory memory, uint32_t segment_index);
+
+
+/*
+* seg0_generation
+* Purpose: To report a counter that changes whenever segment 0 is replaced 
+*          by load program or grown by the loader
+* Input: an instance of the memory manager
+* Expected Output: the current generation
+* Note: memory must not be NULL
+*/
+uint64_t seg0_generation(Memory memory);
+
+
+/*
+* seg0_clean
+* Purpose: To hand each word of segment 0 stored into since the last call 
+*          to apply, in increasing order, and then mark them clean
+* Input: an instance of the memory manager, the function to apply and a 
+*        closure for it
+* Expected Output: none
+* Note: replacing segment 0 also marks every word clean
+*/
+void seg0_clean(Memory memory, void apply(uint32_t word_index, void *cl), 
+                void *cl);
+
+
 /*
 * free_segments
 * Purpose: To free all the allocated memory taken up by the memory segments
 *          and words within those segments.
 * Input: an instance of the memory manager
 * Expected Output: none
-* Note: 
+* Note: takes time proportional to the number of region chunks, not to 
+*       the number of segments or words
 */
 void free_segments(Memory memory);
 
@@ -0,0 +1,399 @@
+/**************************************************************
+ *                     output_buffer.c
+ *
+ *     Assignment: Homework 6 - Universal Machine Program
+ *     Authors: Katie Yang (zyang11) and Pamela Melgar (pmelga01)
+ *     Date: November 24, 2021
+ *
+ *     Purpose: Implementation for output_buffer.h. The buffer is one
+ *              static array; output_char fills it inline, and everything
+ *              else here runs only when it is full or must be emptied.
+ *
+ *              In the asynchronous mode output_char fills a stretch of a
+ *              ring instead, and a full stretch is published to the
+ *              writer thread by moving the ring's head. The program is
+ *              the only producer and the writer the only consumer, so
+ *              head and tail are each stored by one thread and read by
+ *              the other, without a lock. The lock and conditions are
+ *              only there to put a thread to sleep when it has to wait.
+ *
+ *     Success Output:
+ *              the program's output, on stdout
+ *
+ *     Failure output:
+ *              None
+ *
+ **************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <signal.h>
+#include <unistd.h>
+#include <pthread.h>
+
+#include "output_buffer.h"
+#include "assert.h"
+
+/*the size of the buffer: big enough that a write costs little per
+  character, small enough to stay in the cache*/
+#define OUTPUT_BUFFER_BYTES (64 * 1024)
+
+/*the size of the asynchronous ring, and the most the program fills
+  before handing it to the writer*/
+#define RING_BYTES (1024 * 1024)
+#define RING_STRETCH OUTPUT_BUFFER_BYTES
+
+static unsigned char buffer[OUTPUT_BUFFER_BYTES];
+
+struct Output_core output_core = { .start = buffer, .next = buffer,
+                                   .end = buffer + OUTPUT_BUFFER_BYTES,
+                                   .async = false };
+
+/*
+* struct Ring
+* Purpose: The asynchronous mode's ring and its writer thread
+* Members: unsigned char *bytes - RING_BYTES of ring
+*          uint64_t head - how many characters the program has published;
+*                   stored only by the program
+*          uint64_t tail - how many the writer has written; stored only
+*                   by the writer
+*          int program_waiting, writer_waiting - set by a thread while it
+*                   sleeps, so the other knows to wake it
+*          int fd - where the writer writes
+*          pthread_mutex_t lock - held to go to sleep and to wake a thread
+*          pthread_cond_t program_wake, writer_wake - what each sleeps on
+* Notes: head and tail only grow; a count modulo RING_BYTES is a place in
+*        bytes. The flags are checked after the counters are stored, and
+*        the counters after the flags are set, all sequentially
+*        consistent, so one of the two threads always sees the other.
+*/
+struct Ring
+{
+    unsigned char *bytes;
+    uint64_t head;
+    uint64_t tail;
+    int program_waiting;
+    int writer_waiting;
+    int fd;
+    pthread_mutex_t lock;
+    pthread_cond_t program_wake;
+    pthread_cond_t writer_wake;
+};
+
+static struct Ring ring = { .bytes = NULL,
+                            .lock = PTHREAD_MUTEX_INITIALIZER,
+                            .program_wake = PTHREAD_COND_INITIALIZER,
+                            .writer_wake = PTHREAD_COND_INITIALIZER };
+
+static bool start_writer(void);
+static void *writer_main(void *unused);
+static void publish(void);
+static void next_stretch(void);
+static void wait_for_tail(uint64_t target);
+
+/*
+* output_setup
+* Purpose: To set the buffer's room for the chosen mode and have it
+*          drained at exit
+* Parameters: bool unbuffered - whether to write every character at once
+*             bool async - whether a writer thread writes the output
+* Returns: nothing
+* Notes: a program that fails calls exit, which drains the buffer through
+*        the atexit handler, so its output up to the failure is kept as
+*        stdio would have kept it. The handler is registered once however
+*        often this is called, and the writer thread is started at most
+*        once.
+*/
+void output_setup(bool unbuffered, bool async)
+{
+    static bool registered = false;
+
+    assert(!(unbuffered && async));
+
+    output_flush();
+    if (async && (ring.bytes != NULL || start_writer())) {
+        output_core.async = true;
+        next_stretch();
+    }
+    else if (!output_core.async) {
+        output_core.end = unbuffered ? output_core.start
+                                     : output_core.start + OUTPUT_BUFFER_BYTES;
+    }
+    if (!registered) {
+        atexit(output_drain);
+        registered = true;
+    }
+}
+
+/*
+* output_spill
+* Purpose: To put out a character that did not fit in the buffer
+* Parameters: unsigned char c - the character
+* Returns: nothing
+* Notes: buffered, the full buffer is written and c starts it again;
+*        unbuffered, c is written and flushed alone; asynchronous, the
+*        full stretch is published and c starts the next
+*/
+void output_spill(unsigned char c)
+{
+    if (output_core.async) {
+        publish();
+        next_stretch();
+        *output_core.next++ = c;
+        return;
+    }
+
+    output_drain();
+    if (output_core.end == output_core.start) {
+        putchar(c);
+        fflush(stdout);
+    }
+    else {
+        *output_core.next++ = c;
+    }
+}
+
+/*
+* output_drain
+* Purpose: To write the buffer to stdout and empty it
+* Parameters: none
+* Returns: nothing
+* Notes: stdout is flushed too, so the characters reach the file
+*        descriptor now and lockstep finds them in its memory streams.
+*        Asynchronous, what is buffered is published and this waits for
+*        the writer to write all of it; the rest of the stretch stays in
+*        use.
+*/
+void output_drain(void)
+{
+    if (output_core.async) {
+        publish();
+        wait_for_tail(ring.head);
+        return;
+    }
+
+    size_t count = (size_t)(output_core.next - output_core.start);
+
+    if (count != 0) {
+        fwrite(output_core.start, 1, count, stdout);
+        output_core.next = output_core.start;
+    }
+    fflush(stdout);
+}
+
+/*
+* output_bytes
+* Purpose: To put out a block of characters
+* Parameters: const unsigned char *bytes - the characters
+*             size_t count - how many there are
+* Returns: nothing
+* Notes: a block that fits is copied into the buffer; one that does not is
+*        written after the buffer in a single fwrite, or, asynchronous,
+*        copied into the ring a stretch at a time
+*/
+void output_bytes(const unsigned char *bytes, size_t count)
+{
+    assert(bytes != NULL || count == 0);
+
+    if (count <= (size_t)(output_core.end - output_core.next)) {
+        memcpy(output_core.next, bytes, count);
+        output_core.next += count;
+        return;
+    }
+
+    if (output_core.async) {
+        while (count > 0) {
+            size_t room = (size_t)(output_core.end - output_core.next);
+            size_t n = count < room ? count : room;
+
+            memcpy(output_core.next, bytes, n);
+            output_core.next += n;
+            bytes += n;
+            count -= n;
+            if (count > 0) {
+                publish();
+                next_stretch();
+            }
+        }
+        return;
+    }
+
+    output_drain();
+    if (count < (size_t)(output_core.end - output_core.start)) {
+        memcpy(output_core.next, bytes, count);
+        output_core.next += count;
+    }
+    else {
+        fwrite(bytes, 1, count, stdout);
+        fflush(stdout);
+    }
+}
+
+/*
+* start_writer
+* Purpose: To make the ring and start the writer thread
+* Parameters: none
+* Returns: true if it is running
+* Notes: the thread blocks every signal, so they all go to the program's
+*        thread as before. Whatever stdio holds for stdout is flushed
+*        first, since the writer bypasses it.
+*/
+static bool start_writer(void)
+{
+    sigset_t all, old;
+    pthread_t writer;
+
+    ring.bytes = malloc(RING_BYTES);
+    if (ring.bytes == NULL) {
+        return false;
+    }
+    fflush(stdout);
+    ring.fd = fileno(stdout);
+
+    sigfillset(&all);
+    pthread_sigmask(SIG_SETMASK, &all, &old);
+    int failed = pthread_create(&writer, NULL, writer_main, NULL);
+    pthread_sigmask(SIG_SETMASK, &old, NULL);
+
+    if (failed) {
+        free(ring.bytes);
+        ring.bytes = NULL;
+        return false;
+    }
+    pthread_detach(writer);
+    return true;
+}
+
+/*
+* writer_main
+* Purpose: The writer thread: writes what the program publishes, in order,
+*          as it comes
+* Parameters: void *unused - nothing
+* Returns: never
+* Notes: each write takes everything published up to the end of the ring.
+*        A failed write loses its characters, as a failed fwrite would; a
+*        closed pipe raises SIGPIPE for the process as before.
+*/
+static void *writer_main(void *unused)
+{
+    (void)unused;
+
+    for (;;) {
+        uint64_t tail = ring.tail;
+        uint64_t head = __atomic_load_n(&ring.head, __ATOMIC_SEQ_CST);
+
+        if (head == tail) {
+            pthread_mutex_lock(&ring.lock);
+            __atomic_store_n(&ring.writer_waiting, 1, __ATOMIC_SEQ_CST);
+            if (__atomic_load_n(&ring.head, __ATOMIC_SEQ_CST) == tail) {
+                pthread_cond_wait(&ring.writer_wake, &ring.lock);
+            }
+            __atomic_store_n(&ring.writer_waiting, 0, __ATOMIC_SEQ_CST);
+            pthread_mutex_unlock(&ring.lock);
+            continue;
+        }
+
+        size_t at = (size_t)(tail % RING_BYTES);
+        size_t count = (size_t)(head - tail);
+        if (count > RING_BYTES - at) {
+            count = RING_BYTES - at;
+        }
+
+        const unsigned char *bytes = ring.bytes + at;
+        size_t left = count;
+        while (left > 0) {
+            ssize_t n = write(ring.fd, bytes, left);
+            if (n < 0 && errno == EINTR) {
+                continue;
+            }
+            if (n <= 0) {
+                break;
+            }
+            bytes += n;
+            left -= (size_t)n;
+        }
+
+        __atomic_store_n(&ring.tail, tail + count, __ATOMIC_SEQ_CST);
+        if (__atomic_load_n(&ring.program_waiting, __ATOMIC_SEQ_CST)) {
+            pthread_mutex_lock(&ring.lock);
+            pthread_cond_signal(&ring.program_wake);
+            pthread_mutex_unlock(&ring.lock);
+        }
+    }
+    return NULL;
+}
+
+/*
+* publish
+* Purpose: To hand the characters of the stretch so far to the writer
+* Parameters: none
+* Returns: nothing
+* Notes: the rest of the stretch can still be filled
+*/
+static void publish(void)
+{
+    size_t count = (size_t)(output_core.next - output_core.start);
+
+    if (count == 0) {
+        return;
+    }
+    __atomic_store_n(&ring.head, ring.head + count, __ATOMIC_SEQ_CST);
+    output_core.start = output_core.next;
+    if (__atomic_load_n(&ring.writer_waiting, __ATOMIC_SEQ_CST)) {
+        pthread_mutex_lock(&ring.lock);
+        pthread_cond_signal(&ring.writer_wake);
+        pthread_mutex_unlock(&ring.lock);
+    }
+}
+
+/*
+* next_stretch
+* Purpose: To give output_char the next free stretch of the ring
+* Parameters: none
+* Returns: nothing
+* Notes: waits for the writer while the ring is full. A stretch stops at
+*        the end of the ring, at the writer's tail and after RING_STRETCH
+*        characters, so the writer is never kept waiting long.
+*/
+static void next_stretch(void)
+{
+    uint64_t head = ring.head;
+
+    if (head - __atomic_load_n(&ring.tail, __ATOMIC_SEQ_CST) == RING_BYTES) {
+        wait_for_tail(head - RING_BYTES + 1);
+    }
+
+    size_t at = (size_t)(head % RING_BYTES);
+    size_t room = RING_BYTES - (size_t)(head -
+                  __atomic_load_n(&ring.tail, __ATOMIC_SEQ_CST));
+
+    if (room > RING_BYTES - at) {
+        room = RING_BYTES - at;
+    }
+    if (room > RING_STRETCH) {
+        room = RING_STRETCH;
+    }
+    output_core.start = output_core.next = ring.bytes + at;
+    output_core.end = output_core.start + room;
+}
+
+/*
+* wait_for_tail
+* Purpose: To wait until the writer has written up to a count
+* Parameters: uint64_t target - the count of characters
+* Returns: nothing
+*/
+static void wait_for_tail(uint64_t target)
+{
+    while (__atomic_load_n(&ring.tail, __ATOMIC_SEQ_CST) < target) {
+        pthread_mutex_lock(&ring.lock);
+        __atomic_store_n(&ring.program_waiting, 1, __ATOMIC_SEQ_CST);
+        if (__atomic_load_n(&ring.tail, __ATOMIC_SEQ_CST) < target) {
+            pthread_cond_wait(&ring.program_wake, &ring.lock);
+        }
+        __atomic_store_n(&ring.program_waiting, 0, __ATOMIC_SEQ_CST);
+        pthread_mutex_unlock(&ring.lock);
+    }
+}
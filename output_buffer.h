@@ -0,0 +1,141 @@
+/**************************************************************
+ *                     output_buffer.h
+ *
+ *     Assignment: Homework 6 - Universal Machine Program
+ *     Authors: Katie Yang (zyang11) and Pamela Melgar (pmelga01)
+ *     Date: November 24, 2021
+ *
+ *     Purpose: Interface for output_buffer, where the OUT instruction of
+ *              every engine puts its characters. They collect in one
+ *              buffer owned by the machine and reach stdout in large
+ *              writes: when the buffer is full, before the program reads
+ *              input (so a prompt appears before the program waits), when
+ *              it stops, and when it exits on an error. Unbuffered, every
+ *              character is written as it comes. In the asynchronous mode
+ *              the buffer is a ring that a writer thread empties, so the
+ *              program keeps running while its output is written; the
+ *              points above then wait for the ring to be empty.
+ *
+ *     Success Output:
+ *              the program's output, on stdout
+ *
+ *     Failure output:
+ *              None
+ *
+ **************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifndef OUTPUT_BUFFER_H
+#define OUTPUT_BUFFER_H
+
+/*
+* struct Output_core
+* Purpose: Where the next output character goes
+* Members: unsigned char *start - the first character not yet handed 
+*                   on: the buffer, or in the asynchronous mode the part 
+*                   of the ring being filled
+*          unsigned char *next - the first free byte
+*          unsigned char *end - the end of the room characters may take;
+*                   start itself when output is unbuffered
+*          bool async - whether a writer thread empties a ring
+* Notes: The layout is visible only so that output_char and output_flush
+*        can be inlined into the engines; clients should still go through
+*        them
+*/
+struct Output_core
+{
+    unsigned char *start;
+    unsigned char *next;
+    unsigned char *end;
+    bool async;
+};
+
+/*the output buffer of the machine*/
+extern struct Output_core output_core;
+
+
+/*
+* output_setup
+* Purpose: To choose how output is written, and make sure buffered output 
+*          is written when the process exits
+* Input: true to write every character as it comes (--unbuffered), and 
+*        true to have a writer thread write it (--async-output)
+* Expected Output: none
+* Note: call before the program runs; output is buffered until then. Not 
+*       both at once. If the thread cannot be started, output is buffered 
+*       as usual. In the asynchronous mode output goes to file descriptor 
+*       1, not through stdout, so stdout must not be pointed elsewhere.
+*/
+void output_setup(bool unbuffered, bool async);
+
+
+/*
+* output_spill
+* Purpose: To put a character out when the buffer has no room for it
+* Input: the character
+* Expected Output: none
+* Note: only output_char calls it
+*/
+void output_spill(unsigned char c);
+
+
+/*
+* output_drain
+* Purpose: To write what the buffer holds to stdout, and flush stdout
+* Input: none
+* Expected Output: none
+* Note: writes to whatever stdout is at the time. In the asynchronous 
+*       mode, returns once the writer thread has written everything.
+*/
+void output_drain(void);
+
+
+/*
+* output_bytes
+* Purpose: To put a block of characters out, after those already buffered
+* Input: the characters and their number
+* Expected Output: none
+* Note: a block bigger than the buffer is written straight through
+*/
+void output_bytes(const unsigned char *bytes, size_t count);
+
+
+/*
+* output_char
+* Purpose: To put one character out, as the OUT instruction does
+* Input: the character, at most 255
+* Expected Output: none
+* Note: the caller checks the character's range
+*/
+static inline void output_char(uint32_t c)
+{
+    if (output_core.next != output_core.end) {
+        *output_core.next++ = (unsigned char)c;
+    }
+    else {
+        output_spill((unsigned char)c);
+    }
+}
+
+
+/*
+* output_flush
+* Purpose: To get all output so far onto stdout, as the program is about
+*          to read input or stop
+* Input: none
+* Expected Output: none
+* Note: costs one comparison when there is nothing to write, unless a 
+*       writer thread may still be writing
+*/
+static inline void output_flush(void)
+{
+    if (output_core.next != output_core.start || output_core.async) {
+        output_drain();
+    }
+}
+
+#endif
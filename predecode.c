@@ -0,0 +1,398 @@
+/**************************************************************
+ *                     predecode.c
+ * 
+ *     Assignment: Homework 6 - Universal Machine Program
+ *     Authors: Katie Yang (zyang11) and Pamela Melgar (pmelga01)
+ *     Date: November 24, 2021
+ *
+ *     Purpose: Implementation for predecode.h. Segment 0 is decoded in 
+ *              one pass when it is loaded and again whenever load program 
+ *              replaces it. Stores into segment 0 are picked up from the 
+ *              memory manager's dirty bits, so self-modifying programs 
+ *              only pay to re-decode the words they actually change.
+ *              Beside each instruction it keeps the handler the threaded 
+ *              engine should run, which fuses the adjacent opcode pairs 
+ *              listed in superinstructions.h and marks the heads of loops 
+ *              the idiom recognizer can run natively, and the verifier's
+ *              bitmap of which words are valid instructions.
+ *     
+ *     Success Output:
+ *              Depends on the function used
+ * 
+ *     Failure output:
+ *              Run-time errors
+ *                  
+ **************************************************************/
+
+#include <string.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <sys/mman.h>
+
+#include "predecode.h"
+#include "verifier.h"
+#include "assert.h"
+
+/*
+* struct Program
+* Purpose: To hold segment 0 in decoded form
+* Members: Memory memory - the memory manager whose segment 0 is decoded
+*          struct Info *code - one decoded instruction per word
+*          uint8_t *dispatch - one handler number per word
+*          uint64_t *verified - the verifier's bitmap of valid words
+*          uint32_t length - the number of valid entries in code
+*          uint32_t capacity - the number of entries code has room for, so 
+*                   loading a program no larger than the last one does not 
+*                   reallocate
+*          uint64_t generation - segment 0's generation when it was last 
+*                   decoded in full
+*          void *image - if not NULL, a private mapping of a program cache 
+*                   file that code, dispatch and verified point into
+*          size_t image_bytes - the size of that mapping
+* Notes: The client cannot see this implmentation, and will only have 
+*        access to a pointer to this struct
+*/
+struct Program
+{
+    Memory memory;
+    struct Info *code;
+    uint8_t *dispatch;
+    uint64_t *verified;
+    uint32_t length;
+    uint32_t capacity;
+    uint64_t generation;
+    void *image;
+    size_t image_bytes;
+};
+
+/*Which superinstruction, if any, fuses each pair of opcodes*/
+#define PAIR_ENTRY(first, second) [first][second] = SUPER_##first##_##second,
+static const uint8_t pair_handler[16][16] = {
+    SUPERINSTRUCTIONS(PAIR_ENTRY)
+};
+#undef PAIR_ENTRY
+
+/*
+* handler_for
+* Purpose: To choose the handler for one decoded instruction
+* Parameters: const struct Info *code - the decoded program
+*             uint32_t length - the number of instructions in code
+*             uint32_t i - the instruction to choose for
+* Returns: the handler number
+* Notes: a pair is fused only when its second instruction exists, so 
+*        fused handlers need not check the bounds of segment 0. A loop 
+*        head takes precedence over a pair.
+*/
+static uint8_t handler_for(const struct Info *code, uint32_t length, 
+                           uint32_t i)
+{
+    uint8_t op = code[i].op;
+    uint8_t handler = op;
+
+    if (i + 1 < length) {
+        uint8_t super = pair_handler[op][code[i + 1].op];
+        if (super != 0) {
+            handler = super;
+        }
+    }
+    if (idiom_may_start(code, length, i)) {
+        Idiom idiom = idiom_at(code, length, i);
+        if (idiom != IDIOM_NONE) {
+            handler = LOOP_FILL + (idiom - IDIOM_FILL);
+        }
+    }
+    return handler;
+}
+
+/*
+* fuse
+* Purpose: To set the handler of one decoded instruction
+* Parameters: struct Program *program - the program being decoded
+*             uint32_t i - the instruction to choose for
+* Returns: nothing
+*/
+static void fuse(struct Program *program, uint32_t i)
+{
+    program->dispatch[i] = handler_for(program->code, program->length, i);
+}
+
+/*
+* release_arrays
+* Purpose: To give back the storage of code, dispatch and verified
+* Parameters: struct Program *program - the program whose arrays go
+* Returns: nothing, the arrays are NULL and capacity is 0
+* Notes: adopted arrays are unmapped with their cache image, others freed
+*/
+static void release_arrays(struct Program *program)
+{
+    if (program->image != NULL) {
+        munmap(program->image, program->image_bytes);
+        program->image = NULL;
+    }
+    else {
+        free(program->code);
+        free(program->dispatch);
+        free(program->verified);
+    }
+    program->code = NULL;
+    program->dispatch = NULL;
+    program->verified = NULL;
+    program->capacity = 0;
+}
+
+/*
+* decode_all
+* Purpose: To decode every word of the current segment 0
+* Parameters: struct Program *program - the program to refill
+* Returns: nothing
+* Notes: code grows to fit but is never shrunk
+*/
+static void decode_all(struct Program *program)
+{
+    uint32_t length = segmentlength(program->memory, 0);
+    const uint32_t *words = segment_words(program->memory, 0);
+
+    if (length > program->capacity) {
+        release_arrays(program);
+        program->code = malloc((size_t)length * sizeof(struct Info));
+        program->dispatch = malloc(length);
+        program->verified = malloc(VERIFIER_BITMAP_WORDS(length) * 
+                                   sizeof(uint64_t));
+        assert(program->code != NULL && program->dispatch != NULL);
+        assert(program->verified != NULL);
+        program->capacity = length;
+    }
+    for (uint32_t i = 0; i < length; i++) {
+        decode_instruction(words[i], &program->code[i]);
+    }
+    verify_program(words, length, program->verified);
+    program->length = length;
+    for (uint32_t i = 0; i < length; i++) {
+        fuse(program, i);
+    }
+    program->generation = seg0_generation(program->memory);
+}
+
+/*
+* redecode
+* Purpose: To decode a single word of segment 0 again after a store
+* Parameters: uint32_t word_index - the word that was stored into
+*             void *cl - the struct Program being updated
+* Returns: nothing
+* Notes: used as the apply function of seg0_clean
+*/
+static void redecode(uint32_t word_index, void *cl)
+{
+    struct Program *program = cl;
+
+    assert(word_index < program->length);
+    uint32_t word = get_word(program->memory, 0, word_index);
+    struct Info decoded;
+
+    decode_instruction(word, &decoded);
+    verify_word(program->verified, word_index, word);
+
+    /*programs often store a word that decodes the same as before*/
+    if (memcmp(&decoded, &program->code[word_index], sizeof(decoded)) == 0) {
+        return;
+    }
+    program->code[word_index] = decoded;
+
+    /*the word may end the pair before it, or sit inside a loop whose
+      head is up to IDIOM_MAX_LENGTH - 1 words before it. Every one of
+      those heads is fused again, not only those that may still start a
+      loop, so a loop the store broke loses its tag*/
+    uint32_t first = word_index >= IDIOM_MAX_LENGTH - 1 ?
+                     word_index - (IDIOM_MAX_LENGTH - 1) : 0;
+    for (uint32_t i = first; i <= word_index; i++) {
+        fuse(program, i);
+    }
+}
+
+/*
+* program_new
+* Purpose: To create a Program and decode segment 0 into it
+* Parameters: Memory memory - the memory manager, with segment 0 loaded
+* Returns: a heap-allocated Program in step with segment 0
+* Notes: memory must be non-NULL
+*/
+Program program_new(Memory memory)
+{
+    assert(memory != NULL);
+
+    struct Program *program = calloc(1, sizeof(struct Program));
+    assert(program != NULL);
+
+    program->memory = memory;
+    decode_all(program);
+    /*stores made before decoding are already reflected*/
+    seg0_clean(memory, redecode, program);
+    return program;
+}
+
+/*
+* program_adopt
+* Purpose: To create a Program from a decoding done by an earlier run and 
+*          kept in a program cache file, instead of decoding again
+* Parameters: Memory memory - the memory manager, with segment 0 loaded 
+*                   from the same cache file
+*             struct Info *code, uint8_t *dispatch, uint64_t *verified - 
+*                   the decoded form of segment 0, inside image
+*             void *image, size_t image_bytes - a private, writable mapping 
+*                   of the cache file, which the Program now owns
+* Returns: a heap-allocated Program in step with segment 0
+* Notes: redecode writes into the arrays in place; the mapping is private, 
+*        so the cache file never sees it. A load program of a longer 
+*        segment moves the arrays to the heap and unmaps the image.
+*/
+Program program_adopt(Memory memory, struct Info *code, uint8_t *dispatch, 
+                      uint64_t *verified, void *image, size_t image_bytes)
+{
+    assert(memory != NULL && image != NULL);
+
+    struct Program *program = calloc(1, sizeof(struct Program));
+    assert(program != NULL);
+
+    program->memory = memory;
+    program->code = code;
+    program->dispatch = dispatch;
+    program->verified = verified;
+    program->length = segmentlength(memory, 0);
+    program->capacity = program->length;
+    program->image = image;
+    program->image_bytes = image_bytes;
+    program->generation = seg0_generation(memory);
+    seg0_clean(memory, redecode, program);
+    return program;
+}
+
+/*
+* program_matches
+* Purpose: To check a decoded form from a program cache file against the 
+*          words it claims to decode
+* Parameters: const uint32_t *words - segment 0, as loaded
+*             uint32_t length - the number of words
+*             const struct Info *code, const uint8_t *dispatch, 
+*             const uint64_t *verified - the decoded form to check
+* Returns: true if each array holds exactly what decode_all would make
+* Notes: the handlers are only checked once every instruction matched, 
+*        since choosing one reads the instructions after it
+*/
+bool program_matches(const uint32_t *words, uint32_t length, 
+                     const struct Info *code, const uint8_t *dispatch, 
+                     const uint64_t *verified)
+{
+    assert(words != NULL || length == 0);
+    assert(code != NULL && dispatch != NULL && verified != NULL);
+
+    uint64_t *bitmap = calloc(VERIFIER_BITMAP_WORDS(length) + 1, 
+                              sizeof(uint64_t));
+    assert(bitmap != NULL);
+    verify_program(words, length, bitmap);
+
+    bool same = true;
+    for (uint32_t i = 0; i < length && same; i++) {
+        struct Info decoded;
+
+        decode_instruction(words[i], &decoded);
+        same = memcmp(&decoded, &code[i], sizeof(decoded)) == 0 && 
+               is_verified(bitmap, i) == is_verified(verified, i);
+    }
+    for (uint32_t i = 0; i < length && same; i++) {
+        same = dispatch[i] == handler_for(code, length, i);
+    }
+    free(bitmap);
+    return same;
+}
+
+/*
+* program_sync
+* Purpose: To catch the decoded program up with segment 0. A new 
+*          generation means load program replaced segment 0, so all of it 
+*          is decoded; otherwise only words marked dirty by set_word are.
+* Parameters: Program program - the program to update
+* Returns: nothing
+* Notes: cheap when nothing has changed, so it is safe to call after every 
+*        store and load program
+*/
+void program_sync(Program program)
+{
+    assert(program != NULL);
+
+    if (program->generation != seg0_generation(program->memory)) {
+        decode_all(program);
+    }
+    seg0_clean(program->memory, redecode, program);
+}
+
+/*
+* program_code
+* Purpose: To expose the decoded instructions to the execution loop
+* Parameters: Program program - a non-NULL program
+* Returns: the array of decoded instructions
+* Notes: the array moves when a larger program is loaded
+*/
+const struct Info *program_code(Program program)
+{
+    assert(program != NULL);
+
+    return program->code;
+}
+
+/*
+* program_dispatch
+* Purpose: To expose the handler numbers to the threaded engine
+* Parameters: Program program - a non-NULL program
+* Returns: the array of handler numbers, parallel to program_code
+* Notes: the array moves when a larger program is loaded
+*/
+const uint8_t *program_dispatch(Program program)
+{
+    assert(program != NULL);
+
+    return program->dispatch;
+}
+
+/*
+* program_verified
+* Purpose: To expose the verifier's bitmap to the basic engine
+* Parameters: Program program - a non-NULL program
+* Returns: the bitmap, one bit per entry of program_code
+* Notes: the array moves when a larger program is loaded
+*/
+const uint64_t *program_verified(Program program)
+{
+    assert(program != NULL);
+
+    return program->verified;
+}
+
+/*
+* program_length
+* Purpose: To report how many decoded instructions there are
+* Parameters: Program program - a non-NULL program
+* Returns: the number of entries in program_code
+* Notes: equal to the length of segment 0 after each sync
+*/
+uint32_t program_length(Program program)
+{
+    assert(program != NULL);
+
+    return program->length;
+}
+
+/*
+* program_free
+* Purpose: To free a Program and its decoded instructions
+* Parameters: Program *program - a pointer to a non-NULL program
+* Returns: nothing, *program is set to NULL
+* Notes: the memory manager is left alone
+*/
+void program_free(Program *program)
+{
+    assert(program != NULL && *program != NULL);
+
+    release_arrays(*program);
+    free(*program);
+    *program = NULL;
+}
@@ -0,0 +1,159 @@
+/**************************************************************
+ *                     predecode.h
+ * 
+ *     Assignment: Homework 6 - Universal Machine Program
+ *     Authors: Katie Yang (zyang11) and Pamela Melgar (pmelga01)
+ *     Date: November 24, 2021
+ *
+ *     Purpose: Interface for predecode. Keeps segment 0 decoded into a 
+ *              flat array of Info structs, so that the execution loop 
+ *              reads each instruction's fields directly instead of 
+ *              fetching and unpacking the word every time it runs.
+ *     
+ *     Success Output:
+ *              Depends on the function used
+ * 
+ *     Failure output:
+ *              Run-time errors
+ *                  
+ **************************************************************/
+
+#ifndef PREDECODE_H
+#define PREDECODE_H
+
+#include <stdint.h>
+#include "memory_manager.h"
+#include "instruction_retrieval.h"
+#include "superinstructions.h"
+#include "idiom.h"
+
+/*A struct pointer to create a hidden instance of a decoded program*/
+typedef struct Program *Program;
+
+/*
+* Handler numbers kept beside each decoded instruction. 0-15 run the 
+* instruction with that opcode; each pair in superinstructions.h gets the 
+* next number and runs that pair as one fused handler. The last three run 
+* a whole loop found by the idiom recognizer, in Idiom order.
+*/
+#define SUPER_HANDLER(first, second) SUPER_##first##_##second,
+enum Handler {
+    LAST_OPCODE_HANDLER = 15,
+    SUPERINSTRUCTIONS(SUPER_HANDLER)
+    LOOP_FILL,
+    LOOP_COPY,
+    LOOP_SCAN,
+    NUM_HANDLERS
+};
+#undef SUPER_HANDLER
+
+
+/*
+* program_new
+* Purpose: To decode the current segment 0 of a memory manager
+* Input: an instance of the memory manager with segment 0 loaded
+* Expected Output: a Program holding one Info per word of segment 0
+* Note: memory must not be NULL. The Program must be freed with 
+*       program_free before the memory manager is.
+*/
+Program program_new(Memory memory);
+
+
+/*
+* program_adopt
+* Purpose: To take over segment 0's decoded form from a program cache file
+* Input: an instance of the memory manager whose segment 0 was loaded from 
+*        the cache file, the decoded instructions, handler numbers and 
+*        verifier bitmap for it, and the private mapping they live in
+* Expected Output: a Program as program_new would have made it
+* Note: the arrays must hold one entry (one bit for verified) per word of 
+*       segment 0 and be writable. The Program unmaps image when it no 
+*       longer needs it, at the latest in program_free.
+*/
+Program program_adopt(Memory memory, struct Info *code, uint8_t *dispatch, 
+                      uint64_t *verified, void *image, size_t image_bytes);
+
+
+/*
+* program_matches
+* Purpose: To check a decoded form read from a program cache file before 
+*          program_adopt trusts it
+* Input: the words of segment 0 and their number, and the decoded 
+*        instructions, handler numbers and verifier bitmap for them
+* Expected Output: true if they are exactly what program_new would make 
+*                  from the words
+* Note: a file that is stale, corrupt or written by someone else would 
+*       otherwise index registers and handler tables with its own numbers
+*/
+bool program_matches(const uint32_t *words, uint32_t length, 
+                     const struct Info *code, const uint8_t *dispatch, 
+                     const uint64_t *verified);
+
+
+/*
+* program_sync
+* Purpose: To bring the decoded program back in line with segment 0 after 
+*          a load program or a store into segment 0
+* Input: a Program
+* Expected Output: none. A replaced segment 0 is decoded afresh; otherwise 
+*                  only the words stored into since the last sync are.
+* Note: pointers from program_code are invalid after this call
+*/
+void program_sync(Program program);
+
+
+/*
+* program_code
+* Purpose: To give the execution loop the decoded instructions
+* Input: a Program
+* Expected Output: the decoded form of segment 0, indexed by word
+* Note: valid until the next program_sync or program_free
+*/
+const struct Info *program_code(Program program);
+
+
+/*
+* program_dispatch
+* Purpose: To give the threaded engine the handler for each instruction
+* Input: a Program
+* Expected Output: one handler number per entry of program_code: the 
+*                  opcode, or a superinstruction when the entry and the one 
+*                  after it form a fused pair
+* Note: valid until the next program_sync or program_free
+*/
+const uint8_t *program_dispatch(Program program);
+
+
+/*
+* program_verified
+* Purpose: To give the basic engine the verifier's bitmap of segment 0
+* Input: a Program
+* Expected Output: a bitmap for is_verified, covering every entry of 
+*                  program_code; a word's bit is set if it is a valid 
+*                  instruction
+* Note: valid until the next program_sync or program_free
+*/
+const uint64_t *program_verified(Program program);
+
+
+/*
+* program_length
+* Purpose: To report how many instructions program_code holds
+* Input: a Program
+* Expected Output: the length of segment 0 as of the last sync
+* Note: program must not be NULL
+*/
+uint32_t program_length(Program program);
+
+
+/*
+* program_free
+* Purpose: To free a Program and its decoded instructions
+* Input: a pointer to a Program
+* Expected Output: none, *program is set to NULL
+* Note: does not touch the memory manager
+*/
+void program_free(Program *program);
+
+
+#endif
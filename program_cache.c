@@ -0,0 +1,417 @@
+/**************************************************************
+ *                     program_cache.c
+ *
+ *     Assignment: Homework 6 - Universal Machine Program
+ *     Authors: Katie Yang (zyang11) and Pamela Melgar (pmelga01)
+ *     Date: November 24, 2021
+ *
+ *     Purpose: Implementation for program_cache.h. A cache file is a
+ *              header followed by four arrays at 8-byte aligned offsets:
+ *              the words of segment 0, one struct Info per word, the
+ *              verifier bitmap and one handler number per word. All are
+ *              in this machine's byte order, exactly as predecode keeps
+ *              them, so a hit is one mmap and one copy of segment 0.
+ *
+ *     Success Output:
+ *              Depends on the function used
+ *
+ *     Failure output:
+ *              None
+ *
+ **************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <limits.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "program_cache.h"
+#include "verifier.h"
+#include "assert.h"
+
+/*
+* The version of the decoded form. Bump it whenever decode_instruction,
+* the verifier or the idiom recognizer change what they produce; the
+* superinstruction pairs and the sizes below are folded in on their own.
+*/
+#define CACHE_FORMAT "umcache 2"
+
+#define PAIR_NAME(first, second) " " #first "+" #second
+static const char decoder_version[] =
+        CACHE_FORMAT SUPERINSTRUCTIONS(PAIR_NAME);
+#undef PAIR_NAME
+
+static const uint64_t FNV_OFFSET = 14695981039346656037ULL;
+static const uint64_t FNV_PRIME = 1099511628211ULL;
+
+/*
+* struct Cache_header
+* Purpose: The start of every cache file
+* Members: char magic[8] - "UMCACHE"
+*          uint32_t version - engine_version() of the writer
+*          uint32_t length - the number of words of segment 0
+*          uint64_t hash, bytes - the Cache_key of the .um file
+*/
+struct Cache_header
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t length;
+    uint64_t hash;
+    uint64_t bytes;
+};
+
+/*
+* struct Layout
+* Purpose: Where each array of a cache file starts
+* Members: size_t words, code, verified, dispatch - byte offsets
+*          size_t total - the size of the whole file
+*/
+struct Layout
+{
+    size_t words;
+    size_t code;
+    size_t verified;
+    size_t dispatch;
+    size_t total;
+};
+
+static const char MAGIC[8] = "UMCACHE";
+
+/*
+* fnv1a
+* Purpose: To fold bytes into a 64-bit FNV-1a hash
+* Parameters: uint64_t hash - the hash so far, FNV_OFFSET to start
+*             const void *data, size_t size - the bytes to fold in
+* Returns: the new hash
+*/
+static uint64_t fnv1a(uint64_t hash, const void *data, size_t size)
+{
+    const unsigned char *bytes = data;
+
+    for (size_t i = 0; i < size; i++) {
+        hash = (hash ^ bytes[i]) * FNV_PRIME;
+    }
+    return hash;
+}
+
+/*
+* hash_bytes
+* Purpose: To hash the contents of a .um file quickly
+* Parameters: const unsigned char *bytes, size_t size - the contents
+* Returns: the hash
+* Notes: byte-at-a-time FNV-1a is bound by its multiply chain, about 2 ns 
+*        a byte. Here four FNV-1a lanes take one 64-bit word each per step, 
+*        so their multiplies overlap, and the lanes and the tail are folded 
+*        together with plain FNV-1a at the end.
+*/
+static uint64_t hash_bytes(const unsigned char *bytes, size_t size)
+{
+    uint64_t lanes[4] = { FNV_OFFSET, FNV_OFFSET ^ 1, FNV_OFFSET ^ 2, 
+                          FNV_OFFSET ^ 3 };
+    size_t i = 0;
+
+    for (; i + sizeof(lanes) <= size; i += sizeof(lanes)) {
+        uint64_t words[4];
+        memcpy(words, bytes + i, sizeof(words));
+        for (int lane = 0; lane < 4; lane++) {
+            lanes[lane] = (lanes[lane] ^ words[lane]) * FNV_PRIME;
+        }
+    }
+
+    uint64_t hash = fnv1a(FNV_OFFSET, lanes, sizeof(lanes));
+    return fnv1a(hash, bytes + i, size - i);
+}
+
+/*
+* engine_version
+* Purpose: To tell decoded forms made by different builds apart
+* Parameters: none
+* Returns: a hash of CACHE_FORMAT, the superinstruction pairs, and the
+*          sizes the decoded form depends on
+*/
+static uint32_t engine_version(void)
+{
+    const uint32_t sizes[] = { sizeof(struct Info), NUM_HANDLERS,
+                               IDIOM_MAX_LENGTH };
+    uint64_t hash = fnv1a(FNV_OFFSET, decoder_version,
+                          sizeof(decoder_version));
+
+    hash = fnv1a(hash, sizes, sizeof(sizes));
+    return (uint32_t)(hash ^ (hash >> 32));
+}
+
+/*
+* layout_of
+* Purpose: To place the arrays of a cache file for a segment 0
+* Parameters: uint32_t length - the number of words of segment 0
+* Returns: the offsets and total size
+*/
+static struct Layout layout_of(uint32_t length)
+{
+    struct Layout layout;
+
+    layout.words = sizeof(struct Cache_header);
+    layout.code = (layout.words + (size_t)length * sizeof(uint32_t) + 7)
+                  & ~(size_t)7;
+    layout.verified = layout.code + (size_t)length * sizeof(struct Info);
+    layout.dispatch = layout.verified +
+                      VERIFIER_BITMAP_WORDS(length) * sizeof(uint64_t);
+    layout.total = layout.dispatch + length;
+    return layout;
+}
+
+/*
+* cache_path
+* Purpose: To name the cache file of a .um file
+* Parameters: const char *dir - the cache directory
+*             const Cache_key *key - the .um file's key
+*             char path[PATH_MAX] - receives the name
+* Returns: true if the name fit
+*/
+static bool cache_path(const char *dir, const Cache_key *key,
+                       char path[PATH_MAX])
+{
+    int n = snprintf(path, PATH_MAX, "%s/%016llx-%08x.umc", dir,
+                     (unsigned long long)key->hash, engine_version());
+    return n > 0 && n < PATH_MAX;
+}
+
+/*
+* hash_input
+* Purpose: To compute the key of the opened .um file
+* Parameters: FILE *input - the .um file, not yet read from
+*             Cache_key *key - receives the key
+* Returns: the contents, mapped, for the caller to unmap with
+*          key->bytes; NULL if the file is empty or could not be mapped,
+*          and then key->usable tells which
+* Notes: the file is mapped rather than read, so input is left unread
+*/
+static const unsigned char *hash_input(FILE *input, Cache_key *key)
+{
+    struct stat st;
+    int fd = fileno(input);
+
+    key->usable = false;
+    key->hash = hash_bytes((const unsigned char *)"", 0);
+    key->bytes = 0;
+    if (fd < 0 || fstat(fd, &st) != 0 || !S_ISREG(st.st_mode)) {
+        return NULL;
+    }
+
+    key->bytes = (uint64_t)st.st_size;
+    if (key->bytes == 0) {
+        key->usable = true;
+        return NULL;
+    }
+
+    void *bytes = mmap(NULL, key->bytes, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (bytes == MAP_FAILED) {
+        return NULL;
+    }
+    key->hash = hash_bytes(bytes, key->bytes);
+    key->usable = true;
+    return bytes;
+}
+
+/*
+* same_program
+* Purpose: To check a mapped cache file against the .um file it claims
+*          to be for
+* Parameters: const uint32_t *words - the cached segment 0
+*             uint32_t length - the number of words
+*             const unsigned char *bytes - the .um file's contents
+*             uint64_t size - their number
+* Returns: true if the words are the .um file's, read big-endian as
+*          readFile reads them
+* Notes: the hash only picks the file; two programs with the same hash
+*        are told apart here. The decoded form is checked against the
+*        words afterwards, by program_matches.
+*/
+static bool same_program(const uint32_t *words, uint32_t length,
+                         const unsigned char *bytes, uint64_t size)
+{
+    if (size != (uint64_t)length * sizeof(uint32_t)) {
+        return false;
+    }
+    for (uint32_t i = 0; i < length; i++) {
+        const unsigned char *b = bytes + (size_t)i * sizeof(uint32_t);
+        uint32_t word = (uint32_t)b[0] << 24 | (uint32_t)b[1] << 16 |
+                        (uint32_t)b[2] << 8 | b[3];
+
+        if (words[i] != word) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/*
+* load_image
+* Purpose: To map a cache file and, if it is current and for this .um
+*          file, build segment 0 and its Program from it
+* Parameters: const char *path - the cache file
+*             Memory memory - the memory manager, segment 0 empty
+*             const Cache_key *key - the .um file's key
+*             const unsigned char *bytes - the .um file's contents, NULL
+*                   if it is empty
+* Returns: the Program, or NULL on a miss
+*/
+static Program load_image(const char *path, Memory memory,
+                          const Cache_key *key, const unsigned char *bytes)
+{
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        return NULL;
+    }
+
+    struct Cache_header header;
+    struct stat st;
+    bool current = fstat(fd, &st) == 0 &&
+                   pread(fd, &header, sizeof(header), 0) == sizeof(header) &&
+                   memcmp(header.magic, MAGIC, sizeof(MAGIC)) == 0 &&
+                   header.version == engine_version() &&
+                   header.hash == key->hash && header.bytes == key->bytes &&
+                   (size_t)st.st_size == layout_of(header.length).total;
+    void *image = MAP_FAILED;
+
+    if (current) {
+        image = mmap(NULL, (size_t)st.st_size, PROT_READ | PROT_WRITE,
+                     MAP_PRIVATE, fd, 0);
+    }
+    close(fd);
+    if (image == MAP_FAILED) {
+        return NULL;
+    }
+
+    struct Layout layout = layout_of(header.length);
+    char *base = image;
+    const uint32_t *words = (const uint32_t *)(base + layout.words);
+
+    if (!same_program(words, header.length, bytes, key->bytes) ||
+        !program_matches(words, header.length,
+                         (const struct Info *)(base + layout.code),
+                         (const uint8_t *)(base + layout.dispatch),
+                         (const uint64_t *)(base + layout.verified))) {
+        munmap(image, layout.total);
+        return NULL;
+    }
+    load_seg0(memory, words, header.length);
+    return program_adopt(memory, (struct Info *)(base + layout.code),
+                         (uint8_t *)(base + layout.dispatch),
+                         (uint64_t *)(base + layout.verified),
+                         image, layout.total);
+}
+
+/*
+* cache_load
+* Purpose: To map the cache file of the .um file, if there is a current
+*          one, and build segment 0 and its Program from it
+* Parameters: const char *dir - the cache directory
+*             FILE *input - the opened .um file
+*             Memory memory - the memory manager, segment 0 empty
+*             Cache_key *key - receives the .um file's key
+* Returns: the Program on a hit, NULL on a miss
+* Notes: a file from another build or cut short by a crash does not
+*        match its header, one for another .um file with the same hash
+*        does not match the .um file's words, and one whose decoded form
+*        was damaged does not match those words; any of them is a miss,
+*        and cache_store then replaces it
+*/
+Program cache_load(const char *dir, FILE *input, Memory memory,
+                   Cache_key *key)
+{
+    assert(dir != NULL && input != NULL && memory != NULL && key != NULL);
+
+    char path[PATH_MAX];
+
+    const unsigned char *bytes = hash_input(input, key);
+    Program program = NULL;
+
+    if (key->usable && cache_path(dir, key, path)) {
+        program = load_image(path, memory, key, bytes);
+    }
+    if (bytes != NULL) {
+        munmap((void *)bytes, key->bytes);
+    }
+    return program;
+}
+
+/*
+* write_at
+* Purpose: To write one array of a cache file at its offset
+* Parameters: FILE *out - the cache file being written
+*             size_t offset - where the array starts, at or past the
+*                   current position by less than 8 bytes
+*             const void *data, size_t size - the array
+* Returns: true if it was written
+*/
+static bool write_at(FILE *out, size_t offset, const void *data,
+                     size_t size)
+{
+    static const char padding[8];
+    long at = ftell(out);
+
+    assert(at >= 0 && (size_t)at <= offset && offset - at < 8);
+    return fwrite(padding, 1, offset - at, out) == offset - (size_t)at &&
+           fwrite(data, 1, size, out) == size;
+}
+
+/*
+* cache_store
+* Purpose: To write the cache file for segment 0 and its Program
+* Parameters: const char *dir - the cache directory, made if missing
+*             const Cache_key *key - the key from cache_load
+*             Memory memory - the memory manager, segment 0 as loaded
+*             Program program - segment 0 decoded
+* Returns: nothing
+* Notes: the file is written under a temporary name and renamed into
+*        place, so a concurrent run sees the old file, the new one, or
+*        none, never half of one
+*/
+void cache_store(const char *dir, const Cache_key *key, Memory memory,
+                 Program program)
+{
+    assert(dir != NULL && key != NULL && memory != NULL && program != NULL);
+
+    char path[PATH_MAX];
+    char temporary[PATH_MAX + 32];
+
+    if (!key->usable || !cache_path(dir, key, path)) {
+        return;
+    }
+    snprintf(temporary, sizeof(temporary), "%s.%ld.tmp", path,
+             (long)getpid());
+    mkdir(dir, 0777);
+
+    uint32_t length = program_length(program);
+    struct Layout layout = layout_of(length);
+    struct Cache_header header = { .version = engine_version(),
+                                   .length = length, .hash = key->hash,
+                                   .bytes = key->bytes };
+    memcpy(header.magic, MAGIC, sizeof(MAGIC));
+
+    FILE *out = fopen(temporary, "wb");
+    bool written = out != NULL &&
+        write_at(out, 0, &header, sizeof(header)) &&
+        write_at(out, layout.words, segment_words(memory, 0),
+                 (size_t)length * sizeof(uint32_t)) &&
+        write_at(out, layout.code, program_code(program),
+                 (size_t)length * sizeof(struct Info)) &&
+        write_at(out, layout.verified, program_verified(program),
+                 VERIFIER_BITMAP_WORDS(length) * sizeof(uint64_t)) &&
+        write_at(out, layout.dispatch, program_dispatch(program), length);
+
+    if (out != NULL && fclose(out) != 0) {
+        written = false;
+    }
+    if (!written || rename(temporary, path) != 0) {
+        remove(temporary);
+        fprintf(stderr, "um: cannot write program cache %s\n", path);
+    }
+}
@@ -0,0 +1,74 @@
+/**************************************************************
+ *                     program_cache.h
+ *
+ *     Assignment: Homework 6 - Universal Machine Program
+ *     Authors: Katie Yang (zyang11) and Pamela Melgar (pmelga01)
+ *     Date: November 24, 2021
+ *
+ *     Purpose: Interface for the program cache (--cache-dir). A cache
+ *              file holds segment 0 of a .um file together with its
+ *              decoded instructions, handler numbers and verifier bitmap.
+ *              It is named by a hash of the .um file's contents and of the
+ *              decoder's version, so a later run of the same program maps
+ *              it in instead of parsing, decoding and verifying again.
+ *
+ *     Success Output:
+ *              Depends on the function used
+ *
+ *     Failure output:
+ *              None; a missing, stale or unwritable cache file only means
+ *              the program is read and decoded as usual
+ *
+ **************************************************************/
+
+#ifndef PROGRAM_CACHE_H
+#define PROGRAM_CACHE_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include "memory_manager.h"
+#include "predecode.h"
+
+/*
+* struct Cache_key
+* Purpose: What names the cache file of one .um file
+* Members: bool usable - false if the .um file could not be hashed (it is
+*                  not a regular file), in which case nothing is cached
+*          uint64_t hash - an FNV-1a based hash of the .um file's bytes
+*          uint64_t bytes - the .um file's size
+*/
+typedef struct Cache_key {
+        bool usable;
+        uint64_t hash;
+        uint64_t bytes;
+} Cache_key;
+
+
+/*
+* cache_load
+* Purpose: To load segment 0 and its decoded form from the cache
+* Input: the cache directory, the opened .um file, a memory manager whose
+*        segment 0 is still empty, and the key to fill in
+* Expected Output: a Program in step with segment 0 if the cache held this
+*                  program, else NULL with segment 0 left empty and input
+*                  unread, ready for readFile
+* Note: *key is filled in either way, for cache_store after a miss
+*/
+Program cache_load(const char *dir, FILE *input, Memory memory,
+                   Cache_key *key);
+
+
+/*
+* cache_store
+* Purpose: To write the cache file for a program just read and decoded
+* Input: the cache directory, the key cache_load filled in, the memory
+*        manager and the Program made from its segment 0
+* Expected Output: none; the file appears whole or not at all
+* Note: call before the program runs, while segment 0 is as loaded. A
+*       failure to write is reported on stderr and otherwise ignored.
+*/
+void cache_store(const char *dir, const Cache_key *key, Memory memory,
+                 Program program);
+
+#endif
@@ -20,7 +20,7 @@
 #include <stdlib.h>
 
 #include "read_file.h"
-#include "bitpack.h"
+#include "bitfield.h"
 #include "stdint.h"
 #include "assert.h"
 
@@ -59,18 +59,15 @@ void readFile(FILE *input, Memory memory)
     /*Keep reading the file and parsing through "words" until EOF*/
     /*Populate the sequence every time we create a new word*/
     while ((c = fgetc(input)) != EOF) {
-        word = Bitpack_newu(word, 8, 24, c);
+        word = bitfield_newu(word, 8, 24, c);
         counter++;
         for (int lsb = 2 * BYTESIZE; lsb >= 0; lsb = lsb - BYTESIZE) {
             byte = fgetc(input);
-            word = Bitpack_newu(word, BYTESIZE, lsb, byte);
+            word = bitfield_newu(word, BYTESIZE, lsb, byte);
         }
         
-        uint32_t *word_ptr = malloc(sizeof(uint32_t));
-        *word_ptr = word;
-        
-        /*Populate sequence*/
-        add_to_seg0(memory, word_ptr);
+        /*Populate segment 0*/
+        add_to_seg0(memory, word);
     }
 
    fclose(input);
@@ -23,13 +23,30 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <stdint.h>
+#include <assert.h>
 
 #ifndef REGISTER_MANAGER_H
 #define REGISTER_MANAGER_H
 
-/*A struct pointer to create a hidden instance of the Register manager*/
+#define NUM_REGISTERS 8
+
+/*A struct pointer to an instance of the Register manager*/
 typedef struct Registers *Registers;
 
+/*
+* struct Registers
+* Purpose: To hold the 8 REGISTERS used throughout the program
+* Members: uint32_t registers[] - the register values, indexed by the 
+*                   3-bit register numbers of the instructions
+* Notes: The layout is visible only so that the register accessors below 
+*        can be inlined into the execution loop; clients should still go 
+*        through get_register_value and set_register_value
+*/
+struct Registers
+{
+    uint32_t registers[NUM_REGISTERS];
+};
+
 
 /*
 * initialize_registers
@@ -52,9 +69,16 @@ Registers initialize_registers();
 *        representing which register index the value is desired from
 * Expected Output: a uint32_t representing the value contained at the 
 *                  desired register
-* Note: 
+* Note: all_registers must be non-NULL and num_register in bounds
 */
-uint32_t get_register_value(Registers all_registers, uint32_t num_register);
+static inline uint32_t get_register_value(Registers all_registers, 
+                                          uint32_t num_register)
+{
+    assert(all_registers != NULL);
+    assert(num_register < NUM_REGISTERS);
+
+    return all_registers->registers[num_register];
+}
 
 /*
 * set_register_value
@@ -66,10 +90,16 @@ uint32_t get_register_value(Registers all_registers, uint32_t num_register);
 *        and a uint32_t containing the value that will replace the old value
 *        contained in that register
 * Expected Output: none -- sets a value
-* Note: 
+* Note: all_registers must be non-NULL and num_register in bounds
 */
-void set_register_value(Registers all_registers, uint32_t num_register, 
-                        uint32_t value);
+static inline void set_register_value(Registers all_registers, 
+                                      uint32_t num_register, uint32_t value)
+{
+    assert(all_registers != NULL);
+    assert(num_register < NUM_REGISTERS);
+
+    all_registers->registers[num_register] = value;
+}
 
 
 /*
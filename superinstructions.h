@@ -0,0 +1,27 @@
+/**************************************************************
+ *                     superinstructions.h
+ *
+ *     GENERATED by gen_superinstructions.sh from the pair counts of:
+ *         midmark.um
+ *     Do not edit; run "make superinstructions" instead.
+ *
+ *     Purpose: The opcode pairs the threaded engine fuses, most 
+ *              frequent first, as X(FIRST, SECOND) with the counts 
+ *              they were chosen on.
+ *                  
+ **************************************************************/
+
+#ifndef SUPERINSTRUCTIONS_H
+#define SUPERINSTRUCTIONS_H
+
+#define SUPERINSTRUCTIONS(X) \
+        X(LV, SLOAD) /* 12983120 */ \
+        X(LV, SSTORE) /* 12030556 */ \
+        X(SLOAD, LV) /* 10620068 */ \
+        X(LV, LV) /* 3567220 */ \
+        X(NAND, NAND) /* 2332652 */ \
+        X(SLOAD, LOADP) /* 1766890 */ \
+        X(SLOAD, SSTORE) /* 1724243 */ \
+        X(ADD, SLOAD) /* 1666647 */ \
+
+#endif
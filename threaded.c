@@ -0,0 +1,347 @@
+/**************************************************************
+ *                     threaded.c
+ * 
+ *     Assignment: Homework 6 - Universal Machine Program
+ *     Authors: Katie Yang (zyang11) and Pamela Melgar (pmelga01)
+ *     Date: November 24, 2021
+ *
+ *     Implementation for threaded.h
+ *
+ *     Purpose: Runs the decoded program with "threaded" dispatch. Each 
+ *              opcode has a label, the labels' addresses sit in a table 
+ *              indexed by opcode, and every handler ends by jumping 
+ *              straight to the next instruction's handler. Replicating the 
+ *              dispatch at the tail of each handler gives the branch 
+ *              predictor one indirect jump per opcode to learn, instead 
+ *              of a single shared jump (or if/else chain) for all of them.
+ *              The opcode pairs listed in superinstructions.h also get a 
+ *              fused handler, which runs the first instruction and then 
+ *              jumps directly into the second's handler, skipping a 
+ *              dispatch. Loops found by the idiom recognizer get a 
+ *              handler that runs the whole loop natively, or falls back 
+ *              to the head instruction's own handler.
+ *     
+ *     Success Output:
+ *              exit_sucess
+ *              
+ *     Failure output:
+ *              exit_faliure
+ *
+ *     Note: 
+ *              Labels as values are a GNU C extension (gcc and clang). 
+ *              They are wrapped in __extension__ so the file still builds 
+ *              under -pedantic -Werror.
+ *                  
+ **************************************************************/
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <stdint.h>
+
+#include "threaded.h"
+#include "instruction_retrieval.h"
+#include "output_buffer.h"
+#include "input_buffer.h"
+#include "superinstructions.h"
+#include "idiom.h"
+#include "assert.h"
+
+/*jump to the handler of the instruction at the program counter*/
+#define DISPATCH()                                                      \
+        do {                                                            \
+                if (pc >= length) {                                     \
+                        goto off_the_end;                               \
+                }                                                       \
+                info = &code[pc];                                       \
+                __extension__ ({ goto *handlers[dispatch[pc++]]; });    \
+        } while (0)
+
+/*reload the decoded program after it may have changed*/
+#define RELOAD_PROGRAM()                                                \
+        do {                                                            \
+                program_sync(program);                                  \
+                code = program_code(program);                           \
+                dispatch = program_dispatch(program);                   \
+                length = program_length(program);                       \
+        } while (0)
+
+/*register shorthands for the instruction being executed*/
+#define RA (info->rA)
+#define RB (info->rB)
+#define RC (info->rC)
+#define GET(n) (reg[(n)])
+#define SET(n, v) (reg[(n)] = (v))
+
+/*write the local registers back so the Registers API sees them*/
+#define SAVE_REGISTERS() \
+        memcpy(all_registers->registers, reg, sizeof(reg))
+
+/*
+* The work of each instruction that always falls through to the next one, 
+* shared by its own handler and by the fused handlers it starts
+*/
+#define BODY_CMOV                                                       \
+        do {                                                            \
+                if (GET(RC) != 0) {                                     \
+                        SET(RA, GET(RB));                               \
+                }                                                       \
+        } while (0)
+#define BODY_SLOAD SET(RA, get_word(all_segments, GET(RB), GET(RC)))
+#define BODY_ADD SET(RA, GET(RB) + GET(RC))
+#define BODY_MUL SET(RA, GET(RB) * GET(RC))
+#define BODY_DIV SET(RA, GET(RB) / GET(RC))
+#define BODY_NAND SET(RA, ~(GET(RB) & GET(RC)))
+#define BODY_ACTIVATE SET(RB, map_segment(all_segments, GET(RC)))
+#define BODY_INACTIVATE unmap_segment(all_segments, GET(RC))
+#define BODY_OUT                                                        \
+        do {                                                            \
+                uint32_t val = GET(RC);                                 \
+                SAVE_REGISTERS();                                       \
+                assert(val <= 255);                                     \
+                output_char(val);                                       \
+        } while (0)
+#define BODY_IN                                                         \
+        do {                                                            \
+                /*EOF reads back as all ones*/                          \
+                SAVE_REGISTERS();                                       \
+                SET(RC, input_char());                                  \
+        } while (0)
+#define BODY_LV SET(RA, info->value)
+
+/*a fused pair: the first body, then straight into the second handler*/
+#define FUSED_HANDLER(first, second)                                    \
+        fused_##first##_##second:                                       \
+                BODY_##first;                                           \
+                info = &code[pc++];                                     \
+                goto do_##second;
+
+#define FUSED_ADDRESS(first, second) \
+        __extension__ &&fused_##first##_##second,
+
+/*
+* run_threaded
+* Purpose: To execute decoded instructions until halt, following the same 
+*          rules as instruction_executer for every opcode
+* Parameters: Program program - segment 0, decoded
+*             Memory all_segments - a reference to the segment manager 
+*                       used throughout the program.
+*             Registers all_registers - a reference to the register manager 
+*                       used throughout the program.
+*             uint32_t *counter - the program counter to start from; on 
+*                       return it is one past the last instruction run
+*             Um_budget *budget - the instructions run so far and when 
+*                       to pause
+* Returns: EXIT_SUCCESS on halt, EXIT_FAILURE on running off the end, 
+*          UM_PAUSED when the budget ran out
+* Notes: after a store or load program the decoded program is synced and 
+*        the local copies of its arrays and length are refreshed.
+*        The eight UM registers are held in a local array for the whole 
+*        run, where the compiler can keep them in host registers, instead 
+*        of going through all_registers on every access. They are written 
+*        back to all_registers at each IN and OUT, at halt, on running off 
+*        the end and before exiting on an invalid opcode, so a snapshot 
+*        taken through the Registers API at any of those points is exact.
+*        A fused handler is only chosen (by predecode) when the pair's 
+*        second instruction exists, so it needs no bounds check.
+*        Between jumps the program counter only moves forward, so the 
+*        instructions run are counted a block at a time, from the entry 
+*        of the block to wherever it left.
+*/
+int run_threaded(Program program, Memory all_segments, 
+                 Registers all_registers, uint32_t *counter, 
+                 Um_budget *budget)
+{
+    assert(program != NULL);
+    assert(all_segments != NULL);
+    assert(all_registers != NULL);
+    assert(counter != NULL);
+    assert(budget != NULL);
+
+    /*indexed by handler number: opcodes 14 and 15 are the extensions*/
+    static void *const handlers[NUM_HANDLERS] = {
+        __extension__ &&do_CMOV,   __extension__ &&do_SLOAD,
+        __extension__ &&do_SSTORE, __extension__ &&do_ADD,
+        __extension__ &&do_MUL,    __extension__ &&do_DIV,
+        __extension__ &&do_NAND,   __extension__ &&do_HALT,
+        __extension__ &&do_ACTIVATE, __extension__ &&do_INACTIVATE,
+        __extension__ &&do_OUT,    __extension__ &&do_IN,
+        __extension__ &&do_LOADP,  __extension__ &&do_LV,
+        __extension__ &&do_BCOPY,  __extension__ &&do_FILL,
+        SUPERINSTRUCTIONS(FUSED_ADDRESS)
+        __extension__ &&loop_fill, __extension__ &&loop_copy,
+        __extension__ &&loop_scan
+    };
+
+    const struct Info *code = program_code(program);
+    const uint8_t *dispatch = program_dispatch(program);
+    uint32_t length = program_length(program);
+    uint32_t pc = *counter;
+    const struct Info *info;
+    int status;
+    uint32_t reg[NUM_REGISTERS];
+    /*code runs straight on from entry until a load program or a loop*/
+    uint32_t entry = pc;
+    uint32_t head;
+    uint64_t executed = budget->executed;
+    const bool extensions = opcode_valid(BCOPY);
+
+    memcpy(reg, all_registers->registers, sizeof(reg));
+
+    DISPATCH();
+
+do_CMOV:
+    BODY_CMOV;
+    DISPATCH();
+
+do_SLOAD:
+    BODY_SLOAD;
+    DISPATCH();
+
+do_SSTORE:
+    set_word(all_segments, GET(RA), GET(RB), GET(RC));
+    /*only stores into segment 0 can change the program*/
+    if (GET(RA) == 0) {
+        RELOAD_PROGRAM();
+    }
+    DISPATCH();
+
+do_ADD:
+    BODY_ADD;
+    DISPATCH();
+
+do_MUL:
+    BODY_MUL;
+    DISPATCH();
+
+do_DIV:
+    BODY_DIV;
+    DISPATCH();
+
+do_NAND:
+    BODY_NAND;
+    DISPATCH();
+
+do_ACTIVATE:
+    BODY_ACTIVATE;
+    DISPATCH();
+
+do_INACTIVATE:
+    BODY_INACTIVATE;
+    DISPATCH();
+
+do_OUT:
+    BODY_OUT;
+    DISPATCH();
+
+do_IN:
+    BODY_IN;
+    DISPATCH();
+
+do_LOADP:
+    executed += pc - entry;
+    duplicate_segment(all_segments, GET(RB));
+    pc = GET(RC);
+    entry = pc;
+    RELOAD_PROGRAM();
+    goto jumped;
+
+do_LV:
+    BODY_LV;
+    DISPATCH();
+
+do_BCOPY:
+    if (!extensions) {
+        goto do_invalid;
+    }
+    if (info->value == BULK_WRITE) {
+        SAVE_REGISTERS();
+        output_words(all_segments, GET(RA), GET(EXT_PAIR(RA)), GET(RC));
+        DISPATCH();
+    }
+    {
+        /*read sets $r[B], which may be the segment's register*/
+        uint32_t to_segment = GET(RA);
+
+        if (info->value == BULK_READ) {
+            SAVE_REGISTERS();
+            SET(RB, input_words(all_segments, to_segment, GET(EXT_PAIR(RA)),
+                                GET(RC)));
+        }
+        else if (info->value == BULK_COPY) {
+            copy_words(all_segments, to_segment, GET(EXT_PAIR(RA)), GET(RB),
+                       GET(EXT_PAIR(RB)), GET(RC));
+        }
+        else {
+            goto do_invalid;
+        }
+        if (to_segment == 0) {
+            RELOAD_PROGRAM();
+        }
+    }
+    DISPATCH();
+
+do_FILL:
+    if (!extensions) {
+        goto do_invalid;
+    }
+    fill_words(all_segments, GET(RA), GET(EXT_PAIR(RA)), GET(RC), GET(RB));
+    if (GET(RA) == 0) {
+        RELOAD_PROGRAM();
+    }
+    DISPATCH();
+
+    SUPERINSTRUCTIONS(FUSED_HANDLER)
+
+loop_fill:
+    head = pc - 1;
+    if (idiom_run(IDIOM_FILL, info, all_segments, reg, &pc, &executed)) {
+        goto looped;
+    }
+    goto do_ADD;
+
+loop_copy:
+    head = pc - 1;
+    if (idiom_run(IDIOM_COPY, info, all_segments, reg, &pc, &executed)) {
+        goto looped;
+    }
+    goto do_ADD;
+
+loop_scan:
+    head = pc - 1;
+    if (idiom_run(IDIOM_SCAN, info, all_segments, reg, &pc, &executed)) {
+        goto looped;
+    }
+    goto do_SLOAD;
+
+looped:
+    /*idiom_run counted the loop; count the code that led to its head*/
+    executed += head - entry;
+    entry = pc;
+
+jumped:
+    if (executed >= budget->limit) {
+        status = UM_PAUSED;
+        goto done;
+    }
+    DISPATCH();
+
+do_invalid:
+    SAVE_REGISTERS();
+    exit(EXIT_FAILURE);
+
+do_HALT:
+    executed += pc - entry;
+    status = EXIT_SUCCESS;
+    goto done;
+
+off_the_end:
+    executed += pc - entry;
+    status = EXIT_FAILURE;
+
+done:
+    SAVE_REGISTERS();
+    *counter = pc;
+    budget->executed = executed;
+    return status;
+}
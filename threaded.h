@@ -0,0 +1,46 @@
+/**************************************************************
+ *                     threaded.h
+ * 
+ *     Assignment: Homework 6 - Universal Machine Program
+ *     Authors: Katie Yang (zyang11) and Pamela Melgar (pmelga01)
+ *     Date: November 24, 2021
+ *
+ *     Purpose: Interface for the threaded execution engine, an 
+ *              alternative to the instruction_executer loop that 
+ *              dispatches through a table of label addresses. It is 
+ *              chosen at build time (ENGINE=threaded in the Makefile).
+ *     
+ *     Success Output:
+ *              exit_sucess
+ *              
+ *     Failure output:
+ *              exit_faliure
+ *                  
+ **************************************************************/
+
+#ifndef THREADED_H
+#define THREADED_H
+
+#include <stdint.h>
+#include "memory_manager.h"
+#include "register_manager.h"
+#include "predecode.h"
+
+/*
+* run_threaded
+* Purpose: To run a decoded program from a given instruction until it 
+*          halts or runs off the end of segment 0
+* Input: the decoded program, the Memory and Registers of the machine, a 
+*        pointer to the program counter, which is left pointing past the 
+*        last instruction executed, and the budget to count against
+* Expected Output: EXIT_SUCCESS if the program halted, EXIT_FAILURE if it 
+*                  ran off the end of segment 0, UM_PAUSED if it stopped
+*                  because budget->executed reached budget->limit
+* Note: same instruction semantics as instruction_executer, including 
+*       exiting with EXIT_FAILURE on an invalid opcode
+*/
+int run_threaded(Program program, Memory all_segments, 
+                 Registers all_registers, uint32_t *counter, 
+                 Um_budget *budget);
+
+#endif
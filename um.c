@@ -22,21 +22,224 @@
 #include <stdio.h>
 #include "assert.h"
 #include "excution.h"
+#include "memory_manager.h"
+
+static void usage(void);
+static uint64_t parse_size(const char *text);
+static uint64_t parse_count(const char *text);
+static double parse_seconds(const char *text);
+static void print_stats(const Memory_stats *stats);
 
 int main(int argc, char *argv[])
 {
-    /*Progam can only run with two arguments [execute] and [machinecode_file]*/
-    assert(argc > 1 && argc < 3);
-    
-    if (argc != 2) {
-        fprintf(stderr, "Usage: ./um [filename] < [input] > [output]\n");
-        exit(EXIT_FAILURE);
+    Um_options options = { .hugepages = false, .quota_words = 0, 
+                           .pair_profile = NULL, .lockstep = 0, 
+                           .cache_dir = NULL, .extensions = false, 
+                           .max_instructions = 0, .max_seconds = 0, 
+                           .unbuffered = false, .map_input = false, 
+                           .async_output = false };
+    bool want_stats = false;
+
+    /*Options come first, then exactly one [machinecode_file]*/
+    int i = 1;
+    for (; i < argc && strncmp(argv[i], "--", 2) == 0; i++) {
+        if (strcmp(argv[i], "--hugepages") == 0) {
+            options.hugepages = true;
+        }
+        else if (strcmp(argv[i], "--quota") == 0 && i + 1 < argc) {
+            options.quota_words = parse_size(argv[++i]) / sizeof(uint32_t);
+        }
+        else if (strcmp(argv[i], "--stats") == 0) {
+            want_stats = true;
+        }
+        else if (strcmp(argv[i], "--pair-profile") == 0 && i + 1 < argc) {
+            options.pair_profile = argv[++i];
+        }
+        else if (strcmp(argv[i], "--lockstep") == 0 && i + 1 < argc) {
+            options.lockstep = parse_count(argv[++i]);
+        }
+        else if (strcmp(argv[i], "--cache-dir") == 0 && i + 1 < argc) {
+            options.cache_dir = argv[++i];
+        }
+        else if (strcmp(argv[i], "--ext") == 0) {
+            options.extensions = true;
+        }
+        else if (strcmp(argv[i], "--max-instructions") == 0 && 
+                 i + 1 < argc) {
+            options.max_instructions = parse_count(argv[++i]);
+        }
+        else if (strcmp(argv[i], "--max-seconds") == 0 && i + 1 < argc) {
+            options.max_seconds = parse_seconds(argv[++i]);
+        }
+        else if (strcmp(argv[i], "--unbuffered") == 0) {
+            options.unbuffered = true;
+        }
+        else if (strcmp(argv[i], "--map-input") == 0) {
+            options.map_input = true;
+        }
+        else if (strcmp(argv[i], "--async-output") == 0) {
+            options.async_output = true;
+        }
+        else {
+            usage();
+        }
+    }
+
+    if (argc - i != 1 || (options.unbuffered && options.async_output)) {
+        usage();
     }
 
-    FILE *fp = fopen(argv[1], "r");
+    FILE *fp = fopen(argv[i], "r");
     assert(fp != NULL);
 
-    excute(fp);
+    Memory_stats stats;
+    int status = excute(fp, &options, &stats);
+
+    if (want_stats) {
+        print_stats(&stats);
+    }
+
+    return status;
+}
+
+/*
+* parse_size
+* Purpose: To read a byte count such as 512M from the command line
+* Parameters: const char *text - digits with an optional K, M or G suffix
+* Returns: the number of bytes
+* Notes: a malformed size is a usage error
+*/
+static uint64_t parse_size(const char *text)
+{
+    char *end;
+    uint64_t bytes = strtoull(text, &end, 10);
+
+    if (end == text) {
+        usage();
+    }
+
+    switch (*end) {
+        case 'G': case 'g': bytes <<= 10; /* fall through */
+        case 'M': case 'm': bytes <<= 10; /* fall through */
+        case 'K': case 'k': bytes <<= 10; end++; break;
+        case '\0': break;
+        default: usage();
+    }
+
+    if (*end != '\0' || bytes < sizeof(uint32_t)) {
+        usage();
+    }
+    return bytes;
+}
+
+/*
+* parse_count
+* Purpose: To read a positive whole number from the command line
+* Parameters: const char *text - decimal digits
+* Returns: the number, at least 1
+* Notes: anything else is a usage error
+*/
+static uint64_t parse_count(const char *text)
+{
+    char *end;
+    uint64_t count = strtoull(text, &end, 10);
+
+    if (end == text || *end != '\0' || *text == '-' || count == 0) {
+        usage();
+    }
+    return count;
+}
+
+/*
+* parse_seconds
+* Purpose: To read a positive time in seconds from the command line
+* Parameters: const char *text - a decimal number, such as 2 or 0.5
+* Returns: the number of seconds, more than 0
+* Notes: anything else is a usage error
+*/
+static double parse_seconds(const char *text)
+{
+    char *end;
+    double seconds = strtod(text, &end);
 
-    return EXIT_FAILURE;
+    if (end == text || *end != '\0' || !(seconds > 0) || seconds > 1e9) {
+        usage();
+    }
+    return seconds;
+}
+
+/*
+* print_stats
+* Purpose: To report on stderr the memory statistics of a finished run
+* Parameters: const Memory_stats *stats - the statistics from excute
+* Returns: nothing
+*/
+static void print_stats(const Memory_stats *stats)
+{
+    fprintf(stderr, "um: live words %llu (peak %llu), "
+                    "live segments %u (peak %u)\n", 
+            (unsigned long long)stats->live_words, 
+            (unsigned long long)stats->peak_words, 
+            stats->live_segments, stats->peak_segments);
+    fprintf(stderr, "um: reserved %llu bytes, allocator overhead %llu "
+                    "bytes\n", 
+            (unsigned long long)stats->reserved_bytes, 
+            (unsigned long long)stats->overhead_bytes);
+    fprintf(stderr, "um: pool sparse maps %llu, huge maps %llu, "
+                    "spare reuses %llu, retained %llu bytes\n", 
+            (unsigned long long)stats->pool.sparse_maps, 
+            (unsigned long long)stats->pool.huge_maps, 
+            (unsigned long long)stats->pool.spare_reuses, 
+            (unsigned long long)stats->pool.bytes_retained);
+
+    for (int class = 0; class < NUM_SIZE_CLASSES; class++) {
+        if (stats->pool.hits[class] + stats->pool.misses[class] != 0) {
+            fprintf(stderr, "um: pool class 2^%d words: %llu hits, "
+                            "%llu misses\n", class, 
+                    (unsigned long long)stats->pool.hits[class], 
+                    (unsigned long long)stats->pool.misses[class]);
+        }
+    }
+}
+
+/*
+* usage
+* Purpose: To explain the command line and fail when it is not valid
+* Parameters: none
+* Returns: never - exits with EXIT_FAILURE
+*/
+static void usage(void)
+{
+    fprintf(stderr, "Usage: ./um [options] [filename] < [input] > [output]\n"
+                    "Options:\n"
+                    "  --hugepages   put segment 0 and large segments in "
+                    "2 MB huge pages\n"
+                    "  --quota SIZE  fail the program if its segments "
+                    "need more than SIZE bytes (K, M, G)\n"
+                    "  --stats       print memory statistics on stderr "
+                    "when the program stops\n"
+                    "  --pair-profile FILE\n"
+                    "                count adjacent opcode pairs into FILE "
+                    "(runs the basic engine)\n"
+                    "  --lockstep N  check the engine against the reference "
+                    "interpreter every N instructions\n"
+                    "  --cache-dir DIR\n"
+                    "                keep the decoded program in DIR and "
+                    "reuse it on later runs\n"
+                    "  --ext         run opcodes 14 and 15 as the BCOPY and "
+                    "FILL extensions\n"
+                    "  --max-instructions N\n"
+                    "                stop the program (status 3) once it "
+                    "has run about N instructions\n"
+                    "  --max-seconds S\n"
+                    "                stop the program (status 3) once it "
+                    "has run about S seconds\n"
+                    "  --unbuffered  write each output character at once "
+                    "instead of buffering\n"
+                    "  --map-input   map stdin when it is a regular file "
+                    "instead of reading it\n"
+                    "  --async-output\n"
+                    "                write output from a separate thread "
+                    "while the program runs\n");
+    exit(EXIT_FAILURE);
 }
\ No newline at end of file
@@ -0,0 +1,322 @@
+/**************************************************************
+ *                     um2c.c
+ *
+ *     Assignment: Homework 6 - Universal Machine Program
+ *     Authors: Katie Yang (zyang11) and Pamela Melgar (pmelga01)
+ *     Date: November 24, 2021
+ *
+ *     Purpose: Ahead-of-time translator from a .um file to C. Segment 0
+ *              is split into blocks that end at each load program or 
+ *              halt, and each block becomes a C function. Every possible 
+ *              jump target gets a label, reached through a switch on the 
+ *              program counter when the function is entered, and code 
+ *              falls from one instruction to the next. Load program of 
+ *              segment 0 returns the new program counter to the runtime, 
+ *              which calls the block holding it. The C links against 
+ *              libumrt.a (um_runtime.c with memory_manager.c, 
+ *              register_manager.c and the interpreter) into a native 
+ *              program that behaves like ./um on that file.
+ *
+ *              Anything the translation cannot do from the original
+ *              words traps into the runtime's interpreter: a store that
+ *              changes code still ahead in the block being run, a jump 
+ *              to or before a changed word of its block, load program of
+ *              a non-zero segment, division by zero and invalid opcodes.
+ *
+ *     Usage:   um2c [machinecode_file] > [c_file]
+ *
+ *     Success Output:
+ *              the C source on stdout, exit_sucess
+ *
+ *     Failure output:
+ *              exit_faliure
+ *
+ **************************************************************/
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "read_file.h"
+#include "memory_manager.h"
+#include "instruction_retrieval.h"
+#include "assert.h"
+
+/*Image words written per line*/
+#define WORDS_PER_LINE 6
+
+static bool *find_entries(const uint32_t *words, uint32_t length);
+static void write_block(FILE *out, const uint32_t *words, const bool *entry,
+                        uint32_t first, uint32_t end, uint32_t block);
+static void write_instruction(FILE *out, const struct Info *info,
+                              uint32_t pc);
+static bool ends_block(uint32_t word);
+
+int main(int argc, char *argv[])
+{
+    if (argc != 2) {
+        fprintf(stderr, "Usage: %s [machinecode_file] > [c_file]\n",
+                argv[0]);
+        exit(EXIT_FAILURE);
+    }
+
+    FILE *fp = fopen(argv[1], "r");
+    assert(fp != NULL);
+
+    Memory memory = initialize_memory();
+    readFile(fp, memory);
+
+    uint32_t length = segmentlength(memory, 0);
+    const uint32_t *words = segment_words(memory, 0);
+    FILE *out = stdout;
+    bool *entry = find_entries(words, length);
+
+    fprintf(out, "/* Generated by um2c from %s; do not edit. */\n\n",
+            argv[1]);
+    fprintf(out, "#include <stdlib.h>\n#include \"um_runtime.h\"\n\n");
+
+    fprintf(out, "static const uint32_t image[%u + 1] = {", length);
+    for (uint32_t i = 0; i < length; i++) {
+        fprintf(out, "%s0x%08x,", i % WORDS_PER_LINE == 0 ? "\n    " : " ",
+                words[i]);
+    }
+    fprintf(out, "\n    0\n};\n\n");
+
+    uint32_t num_entries = 0;
+    fprintf(out, "static const uint32_t entries[] = {");
+    for (uint32_t pc = 0; pc < length; pc++) {
+        if (entry[pc]) {
+            fprintf(out, "%s%u,", num_entries % WORDS_PER_LINE == 0 ?
+                    "\n    " : " ", pc);
+            num_entries++;
+        }
+    }
+    fprintf(out, "\n    0\n};\n\n");
+
+    /*blocks are numbered as um_main numbers them; only those with an 
+      entry get a function*/
+    bool *written = calloc((size_t)length + 1, sizeof(bool));
+    uint32_t num_blocks = 0;
+    uint32_t first = 0;
+    assert(written != NULL);
+
+    for (uint32_t pc = 0; pc <= length; pc++) {
+        if (pc < length && entry[pc]) {
+            written[num_blocks] = true;
+        }
+        if (pc == length || ends_block(words[pc])) {
+            uint32_t end = pc == length ? length : pc + 1;
+
+            if (written[num_blocks]) {
+                write_block(out, words, entry, first, end, num_blocks);
+            }
+            num_blocks++;
+            first = end;
+        }
+    }
+
+    fprintf(out, "static Um_block *const blocks[%u] = {", num_blocks);
+    for (uint32_t block = 0; block < num_blocks; block++) {
+        if (written[block]) {
+            fprintf(out, "\n    block_%u,", block);
+        }
+        else {
+            fprintf(out, "\n    NULL,");
+        }
+    }
+    fprintf(out, "\n};\n\n");
+
+    fprintf(out, "int main(int argc, char *argv[])\n{\n"
+                 "    return um_main(argc, argv, image, %u, entries, %u, "
+                 "blocks);\n}\n", length, num_entries);
+
+    free(written);
+    free(entry);
+    free_segments(memory);
+    return fflush(out) == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+/*
+* ends_block
+* Purpose: To tell whether straight-line code stops after a word
+* Parameters: uint32_t word - a word of segment 0
+* Returns: true for load program and halt
+* Notes: um_main splits segment 0 into blocks with the same rule
+*/
+static bool ends_block(uint32_t word)
+{
+    struct Info info;
+
+    decode_instruction(word, &info);
+    return info.op == LOADP || info.op == HALT;
+}
+
+/*
+* find_entries
+* Purpose: To decide which words load program might jump to
+* Parameters: const uint32_t *words - segment 0
+*             uint32_t length - its length
+* Returns: a malloc'd array, true for each possible target
+* Notes: the targets are word 0, every load value immediate that is an 
+*        index into segment 0, which covers jumps built with load value, and
+*        the word after each load program, where a call returns to. A jump 
+*        anywhere else is still correct: it goes to the interpreter until 
+*        the next jump lands on a target.
+*/
+static bool *find_entries(const uint32_t *words, uint32_t length)
+{
+    bool *entry = calloc((size_t)length + 1, sizeof(bool));
+    assert(entry != NULL);
+
+    entry[0] = true;
+    for (uint32_t pc = 0; pc < length; pc++) {
+        struct Info info;
+
+        decode_instruction(words[pc], &info);
+        if (info.op == LV && info.value < length) {
+            entry[info.value] = true;
+        }
+        else if (info.op == LOADP && pc + 1 < length) {
+            entry[pc + 1] = true;
+        }
+    }
+    return entry;
+}
+
+/*
+* write_block
+* Purpose: To write the function for one block: a switch from the entry 
+*          program counter to its label, the straight-line code, and the 
+*          trap into the interpreter
+* Parameters: FILE *out - the C file
+*             const uint32_t *words - segment 0
+*             const bool *entry - the possible jump targets
+*             uint32_t first, end - the block's words, end not included
+*             uint32_t block - its number
+* Returns: nothing
+* Notes: a function per block keeps each one small enough for the C 
+*        compiler to optimize quickly. Words that no entry falls through 
+*        to are left out.
+*/
+static void write_block(FILE *out, const uint32_t *words, const bool *entry,
+                        uint32_t first, uint32_t end, uint32_t block)
+{
+    fprintf(out, "static uint32_t block_%u(Um_runtime runtime, Memory m,\n"
+                 "                         Registers registers, uint32_t pc)"
+                 "\n{\n"
+                 "    uint32_t r0, r1, r2, r3, r4, r5, r6, r7;\n\n"
+                 "    (void)m;\n"
+                 "    UM_LOAD(registers);\n"
+                 "    switch (pc) {\n", block);
+    for (uint32_t pc = first; pc < end; pc++) {
+        if (entry[pc]) {
+            fprintf(out, "    case %u: goto L%u;\n", pc, pc);
+        }
+    }
+    fprintf(out, "    default: goto trap;\n    }\n\n");
+
+    bool reachable = false;
+    for (uint32_t pc = first; pc < end; pc++) {
+        struct Info info;
+
+        decode_instruction(words[pc], &info);
+        if (entry[pc]) {
+            fprintf(out, "L%u:\n", pc);
+            reachable = true;
+        }
+        if (reachable) {
+            write_instruction(out, &info, pc);
+        }
+    }
+    if (!ends_block(words[end - 1])) {
+        /*the last block runs off the end of segment 0*/
+        fprintf(out, "    pc = %u;\n", end);
+    }
+
+    fprintf(out, "\ntrap:\n"
+                 "    UM_SAVE(registers);\n"
+                 "    return um_interpret(runtime, pc);\n}\n\n");
+}
+
+/*
+* write_instruction
+* Purpose: To write the C statement for one word of segment 0
+* Parameters: FILE *out - the C file
+*             const struct Info *info - the word, decoded
+*             uint32_t pc - its index in segment 0
+* Returns: nothing
+* Notes: an instruction that traps leaves pc at the instruction the
+*        interpreter should run next
+*/
+static void write_instruction(FILE *out, const struct Info *info,
+                              uint32_t pc)
+{
+    unsigned a = info->rA, b = info->rB, c = info->rC;
+
+    switch (info->op) {
+    case CMOV:
+        fprintf(out, "    if (r%u != 0) {\n        r%u = r%u;\n    }\n",
+                c, a, b);
+        break;
+    case SLOAD:
+        fprintf(out, "    r%u = get_word(m, r%u, r%u);\n", a, b, c);
+        break;
+    case SSTORE:
+        fprintf(out, "    if (r%u != 0) {\n"
+                     "        set_word(m, r%u, r%u, r%u);\n"
+                     "    }\n"
+                     "    else if (um_store0(runtime, r%u, r%u, %u)) {\n"
+                     "        pc = %u;\n"
+                     "        goto trap;\n"
+                     "    }\n", a, a, b, c, b, c, pc + 1, pc + 1);
+        break;
+    case ADD:
+        fprintf(out, "    r%u = r%u + r%u;\n", a, b, c);
+        break;
+    case MUL:
+        fprintf(out, "    r%u = r%u * r%u;\n", a, b, c);
+        break;
+    case DIV:
+        fprintf(out, "    if (r%u == 0) {\n"
+                     "        pc = %u;\n"
+                     "        goto trap;\n"
+                     "    }\n"
+                     "    r%u = r%u / r%u;\n", c, pc, a, b, c);
+        break;
+    case NAND:
+        fprintf(out, "    r%u = ~(r%u & r%u);\n", a, b, c);
+        break;
+    case HALT:
+        /*the interpreter halts, as it would*/
+        fprintf(out, "    pc = %u;\n    goto trap;\n", pc);
+        break;
+    case ACTIVATE:
+        fprintf(out, "    r%u = map_segment(m, r%u);\n", b, c);
+        break;
+    case INACTIVATE:
+        fprintf(out, "    unmap_segment(m, r%u);\n", c);
+        break;
+    case OUT:
+        fprintf(out, "    UM_OUT(r%u);\n", c);
+        break;
+    case IN:
+        fprintf(out, "    UM_IN(r%u);\n", c);
+        break;
+    case LOADP:
+        fprintf(out, "    if (r%u != 0) {\n"
+                     "        pc = %u;\n"
+                     "        goto trap;\n"
+                     "    }\n"
+                     "    UM_SAVE(registers);\n"
+                     "    return r%u;\n", b, pc, c);
+        break;
+    case LV:
+        fprintf(out, "    r%u = %uu;\n", a, info->value);
+        break;
+    default:
+        fprintf(out, "    pc = %u;\n    goto trap;\n", pc);
+        break;
+    }
+}
@@ -0,0 +1,248 @@
+/**************************************************************
+ *                     um_runtime.c
+ *
+ *     Assignment: Homework 6 - Universal Machine Program
+ *     Authors: Katie Yang (zyang11) and Pamela Melgar (pmelga01)
+ *     Date: November 24, 2021
+ *
+ *     Implementation for um_runtime.h
+ *
+ *     Purpose: The runtime library of programs compiled by um2c. The
+ *              embedded segment 0 is split into blocks, each running up
+ *              to and including a load program or halt instruction, which
+ *              is as far as straight-line code can go. A store into
+ *              segment 0 that changes a word marks its block dirty from
+ *              the start of the block up to that word, and the generated
+ *              code only jumps into a block past its dirty part; the rest
+ *              of the program runs on execute_instruction, the same
+ *              interpreter as ./um uses.
+ *
+ *     Success Output:
+ *              exit_sucess
+ *
+ *     Failure output:
+ *              exit_faliure
+ *
+ **************************************************************/
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "um_runtime.h"
+#include "instruction_retrieval.h"
+#include "assert.h"
+
+/*
+* struct Um_runtime
+* Purpose: The machine a compiled program runs on
+* Members: Memory memory - the segments
+*          Registers registers - the registers, valid while the
+*                   interpreter runs
+*          const uint32_t *image - segment 0 as it was compiled
+*          uint32_t length - the number of words in image
+*          bool *entry - entry[i] is true if the generated code has a 
+*                   label for word i
+*          uint32_t *block_of - block_of[i] is the block holding word i
+*          uint32_t *dirty_end - one past the last changed word of each
+*                   block, or 0 if none has changed
+*          bool replaced - true once load program replaced segment 0, so
+*                   the generated code no longer describes it
+*          int status - how the program ended, once it has
+*/
+struct Um_runtime
+{
+    Memory memory;
+    Registers registers;
+    const uint32_t *image;
+    uint32_t length;
+    bool *entry;
+    uint32_t *block_of;
+    uint32_t *dirty_end;
+    bool replaced;
+    int status;
+};
+
+/*
+* um_main
+* Purpose: To set up the machine with the embedded segment 0, run the
+*          generated code and tear the machine down again
+* Parameters: int argc, char *argv[] - the command line, which must have
+*                     no arguments
+*             const uint32_t *image, uint32_t length - segment 0
+*             const uint32_t *entries, uint32_t num_entries - the 
+*                     program counters the generated code can jump to
+*             Um_block *const blocks[] - the generated code
+* Returns: EXIT_SUCCESS if the program halted, EXIT_FAILURE if it ran off 
+*          the end of segment 0
+* Notes: blocks are numbered by how many load program and halt
+*        instructions come before them, as um2c numbers them
+*/
+int um_main(int argc, char *argv[], const uint32_t *image, uint32_t length,
+            const uint32_t *entries, uint32_t num_entries, 
+            Um_block *const blocks[])
+{
+    if (argc != 1) {
+        fprintf(stderr, "Usage: %s < [stdin_file]\n", argv[0]);
+        exit(EXIT_FAILURE);
+    }
+
+    struct Um_runtime runtime = { .image = image, .length = length };
+    uint32_t block = 0;
+
+    runtime.memory = initialize_memory();
+    runtime.registers = initialize_registers();
+    output_setup(false, false);
+    input_setup(false);
+    runtime.block_of = malloc(((size_t)length + 1) * sizeof(uint32_t));
+    assert(runtime.block_of != NULL);
+
+    for (uint32_t i = 0; i < length; i++) {
+        struct Info info;
+
+        add_to_seg0(runtime.memory, image[i]);
+        decode_instruction(image[i], &info);
+        runtime.block_of[i] = block;
+        if (info.op == LOADP || info.op == HALT) {
+            block++;
+        }
+    }
+    runtime.dirty_end = calloc((size_t)block + 1, sizeof(uint32_t));
+    runtime.entry = calloc((size_t)length + 1, sizeof(bool));
+    assert(runtime.dirty_end != NULL && runtime.entry != NULL);
+    for (uint32_t i = 0; i < num_entries; i++) {
+        assert(entries[i] < length);
+        runtime.entry[entries[i]] = true;
+    }
+
+    uint32_t pc = 0;
+    while (pc != UM_STOPPED) {
+        if (um_clean(&runtime, pc)) {
+            pc = blocks[runtime.block_of[pc]](&runtime, runtime.memory, 
+                                              runtime.registers, pc);
+        }
+        else {
+            pc = um_interpret(&runtime, pc);
+        }
+    }
+
+    int status = runtime.status;
+
+    output_flush();
+    free(runtime.entry);
+    free(runtime.block_of);
+    free(runtime.dirty_end);
+    free_registers(runtime.registers);
+    free_segments(runtime.memory);
+    return status;
+}
+
+/*
+* um_clean
+* Purpose: To tell whether the generated code has a label for pc that 
+*          still matches segment 0 up to the end of pc's block
+* Parameters: Um_runtime runtime - the runtime
+*             uint32_t pc - a program counter
+* Returns: true if the generated code may run from pc
+* Notes: a pc past the end is never clean, so the interpreter reports it.
+*        Data often sits just before the code of a block, so stores into it
+*        leave the code after it clean.
+*/
+bool um_clean(Um_runtime runtime, uint32_t pc)
+{
+    return !runtime->replaced && pc < runtime->length && 
+           runtime->entry[pc] && runtime->dirty_end[runtime->block_of[pc]] <= pc;
+}
+
+/*
+* mark_store
+* Purpose: To record a store into segment 0
+* Parameters: Um_runtime runtime - the runtime
+*             uint32_t word_index - the word stored into
+*             uint32_t word - the word now there
+* Returns: true if the word no longer matches the embedded segment 0
+*/
+static bool mark_store(Um_runtime runtime, uint32_t word_index,
+                       uint32_t word)
+{
+    if (runtime->replaced || word_index >= runtime->length ||
+        runtime->image[word_index] == word) {
+        return false;
+    }
+
+    uint32_t *dirty_end = &runtime->dirty_end[runtime->block_of[word_index]];
+
+    if (*dirty_end <= word_index) {
+        *dirty_end = word_index + 1;
+    }
+    return true;
+}
+
+/*
+* um_store0
+* Purpose: To store into segment 0 for the generated code
+* Parameters: Um_runtime runtime - the runtime
+*             uint32_t word_index, word - what to store where
+*             uint32_t next - the instruction after the store
+* Returns: true if the store changed a word from next to the end of its
+*          block, so the generated code must stop running it
+* Notes: set_word checks the bounds
+*/
+bool um_store0(Um_runtime runtime, uint32_t word_index, uint32_t word,
+               uint32_t next)
+{
+    set_word(runtime->memory, 0, word_index, word);
+
+    return mark_store(runtime, word_index, word) && word_index >= next &&
+           runtime->block_of[word_index] == runtime->block_of[next - 1];
+}
+
+/*
+* um_interpret
+* Purpose: To run instructions with execute_instruction until the program
+*          stops or jumps into a clean block
+* Parameters: Um_runtime runtime - the runtime, registers saved
+*             uint32_t pc - the first instruction to run
+* Returns: where the generated code should resume, or UM_STOPPED
+* Notes: words are decoded from segment 0 as it is now, so this is
+*        correct whatever the program has stored or loaded
+*/
+uint32_t um_interpret(Um_runtime runtime, uint32_t pc)
+{
+    assert(runtime != NULL);
+
+    Memory memory = runtime->memory;
+    uint32_t *reg = runtime->registers->registers;
+
+    for (;;) {
+        if (pc >= segmentlength(memory, 0)) {
+            runtime->status = EXIT_FAILURE;
+            return UM_STOPPED;
+        }
+
+        struct Info info;
+        decode_instruction(get_word(memory, 0, pc), &info);
+        pc++;
+
+        uint32_t value_a = reg[info.rA];
+        uint32_t value_b = reg[info.rB];
+        uint32_t value_c = reg[info.rC];
+
+        if (!execute_instruction(&info, memory, runtime->registers, &pc)) {
+            runtime->status = EXIT_SUCCESS;
+            return UM_STOPPED;
+        }
+
+        if (info.op == SSTORE && value_a == 0) {
+            mark_store(runtime, value_b, value_c);
+        }
+        else if (info.op == LOADP && value_b != 0) {
+            runtime->replaced = true;
+        }
+        else if (info.op == LOADP && um_clean(runtime, pc)) {
+            return pc;
+        }
+    }
+}
@@ -0,0 +1,144 @@
+/**************************************************************
+ *                     um_runtime.h
+ *
+ *     Assignment: Homework 6 - Universal Machine Program
+ *     Authors: Katie Yang (zyang11) and Pamela Melgar (pmelga01)
+ *     Date: November 24, 2021
+ *
+ *     Purpose: Interface between the C that um2c generates from a .um
+ *              file and the runtime library (libumrt.a) it links
+ *              against. The runtime owns the Memory and Registers, loads
+ *              the embedded copy of segment 0, and holds the interpreter
+ *              the generated code traps into when its translation of
+ *              segment 0 might no longer match what segment 0 holds.
+ *
+ *     Success Output:
+ *              exit_sucess
+ *
+ *     Failure output:
+ *              exit_faliure
+ *
+ *     Note:
+ *              The generated code keeps the UM registers in locals named
+ *              r0 to r7; UM_SAVE and UM_LOAD copy them to and from the
+ *              runtime's Registers around a trap.
+ *
+ **************************************************************/
+
+#ifndef UM_RUNTIME_H
+#define UM_RUNTIME_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <assert.h>
+#include "memory_manager.h"
+#include "register_manager.h"
+#include "output_buffer.h"
+#include "input_buffer.h"
+
+/*A struct pointer to create a hidden instance of the runtime*/
+typedef struct Um_runtime *Um_runtime;
+
+/*Returned by um_interpret once the program has stopped*/
+#define UM_STOPPED UINT32_MAX
+
+/*
+* The generated function for one block: runs from pc, which must be one of 
+* the block's labels, and returns the next program counter, or UM_STOPPED 
+* once the program has stopped (see um_interpret). The registers are in 
+* registers on entry and on return.
+*/
+typedef uint32_t Um_block(Um_runtime runtime, Memory m, Registers registers, 
+                          uint32_t pc);
+
+/*copy the generated code's r0-r7 into the runtime's registers, and back*/
+#define UM_SAVE(registers)                                              \
+        do {                                                            \
+                uint32_t *saved = (registers)->registers;               \
+                saved[0] = r0; saved[1] = r1; saved[2] = r2;            \
+                saved[3] = r3; saved[4] = r4; saved[5] = r5;            \
+                saved[6] = r6; saved[7] = r7;                           \
+        } while (0)
+#define UM_LOAD(registers)                                              \
+        do {                                                            \
+                const uint32_t *saved = (registers)->registers;         \
+                r0 = saved[0]; r1 = saved[1]; r2 = saved[2];            \
+                r3 = saved[3]; r4 = saved[4]; r5 = saved[5];            \
+                r6 = saved[6]; r7 = saved[7];                           \
+        } while (0)
+
+/*output and input, as execute_instruction does them*/
+#define UM_OUT(value)                                                   \
+        do {                                                            \
+                assert((value) <= 255);                                 \
+                output_char(value);                                     \
+        } while (0)
+#define UM_IN(reg)                                                      \
+        do {                                                            \
+                /*EOF reads back as all ones*/                          \
+                (reg) = input_char();                                   \
+        } while (0)
+
+
+/*
+* um_main
+* Purpose: The main function of a compiled program: sets up the machine
+*          with the embedded segment 0 and runs it, calling the generated 
+*          block for each clean program counter and the interpreter for 
+*          the rest
+* Input: the command line, the words of segment 0 as um2c read them, the 
+*        program counters the generated code has a label for, and the 
+*        generated blocks indexed by block number (NULL for blocks with no 
+*        label)
+* Expected Output: the program's exit status, as ./um would return it
+* Note: a compiled program takes no arguments
+*/
+int um_main(int argc, char *argv[], const uint32_t *image, uint32_t length,
+            const uint32_t *entries, uint32_t num_entries, 
+            Um_block *const blocks[]);
+
+
+/*
+* um_clean
+* Purpose: To tell the generated code whether it may run its translation
+*          of the instruction at pc
+* Input: the runtime and a program counter within the embedded segment 0
+* Expected Output: true if the generated code has a label for pc, segment 
+*                  0 is still the embedded one and no word from pc to the 
+*                  end of its block has been changed
+* Note: a block runs up to and including the next load program or halt in
+*       the embedded segment 0, the furthest straight-line code can go
+*/
+bool um_clean(Um_runtime runtime, uint32_t pc);
+
+
+/*
+* um_store0
+* Purpose: A segmented store into segment 0 from generated code
+* Input: the runtime, the word index and word to store, and the program
+*        counter of the instruction after the store
+* Expected Output: true if the store changed a word the generated code
+*                  would still run before leaving the block, so it must
+*                  trap at once
+* Note: fails like set_word if the index is out of bounds
+*/
+bool um_store0(Um_runtime runtime, uint32_t word_index, uint32_t word,
+               uint32_t next);
+
+
+/*
+* um_interpret
+* Purpose: To run the program with execute_instruction from pc until it
+*          stops, or until a jump lands in a clean block of the embedded
+*          segment 0 where the generated code can take over
+* Input: the runtime, with the registers saved, and the program counter
+* Expected Output: the program counter to resume the generated code at,
+*                  or UM_STOPPED once the program has halted or failed
+* Note: after load program of a non-zero segment, the generated code is
+*       never resumed
+*/
+uint32_t um_interpret(Um_runtime runtime, uint32_t pc);
+
+
+#endif
@@ -0,0 +1,92 @@
+/**************************************************************
+ *                     verifier.c
+ *
+ *     Assignment: Homework 6 - Universal Machine Program
+ *     Authors: Katie Yang (zyang11) and Pamela Melgar (pmelga01)
+ *     Date: November 24, 2021
+ *
+ *     Purpose: Implementation for verifier.h. The bitmap has one bit per
+ *              word of segment 0, so the program keeps it beside its
+ *              decoded instructions at a thirty-second of their size.
+ *
+ *     Success Output:
+ *              Depends on the function used
+ *
+ *     Failure output:
+ *              None
+ *
+ **************************************************************/
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "verifier.h"
+#include "bitfield.h"
+#include "assert.h"
+
+/*
+* valid_word
+* Purpose: To decide whether a word is an instruction the UM can run
+* Parameters: uint32_t word - a word of segment 0
+* Returns: true if its opcode is 0 to 13
+* Notes: every register field is 3 bits wide, so it always names one of
+*        the eight registers
+*/
+static bool valid_word(uint32_t word)
+{
+    return bitfield_getu(word, 4, 28) <= LV;
+}
+
+/*
+* verify_program
+* Purpose: To fill in the bitmap for a whole segment 0
+* Parameters: const uint32_t *words - segment 0
+*             uint32_t length - its number of words
+*             uint64_t *bitmap - VERIFIER_BITMAP_WORDS(length) words
+* Returns: how many words are not valid instructions
+* Notes: bits past length are left clear
+*/
+uint32_t verify_program(const uint32_t *words, uint32_t length,
+                        uint64_t *bitmap)
+{
+    assert(words != NULL || length == 0);
+    assert(bitmap != NULL || length == 0);
+
+    uint32_t invalid = 0;
+
+    for (size_t i = 0; i < VERIFIER_BITMAP_WORDS(length); i++) {
+        bitmap[i] = 0;
+    }
+    for (uint32_t i = 0; i < length; i++) {
+        if (valid_word(words[i])) {
+            bitmap[i / 64] |= (uint64_t)1 << (i % 64);
+        }
+        else {
+            invalid++;
+        }
+    }
+    return invalid;
+}
+
+/*
+* verify_word
+* Purpose: To bring one bit of the bitmap in line with a stored word
+* Parameters: uint64_t *bitmap - the bitmap of segment 0
+*             uint32_t word_index - the word that was stored into
+*             uint32_t word - its new value
+* Returns: nothing
+* Notes: bitmap must not be NULL
+*/
+void verify_word(uint64_t *bitmap, uint32_t word_index, uint32_t word)
+{
+    assert(bitmap != NULL);
+
+    uint64_t bit = (uint64_t)1 << (word_index % 64);
+
+    if (valid_word(word)) {
+        bitmap[word_index / 64] |= bit;
+    }
+    else {
+        bitmap[word_index / 64] &= ~bit;
+    }
+}
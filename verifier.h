@@ -0,0 +1,160 @@
+/**************************************************************
+ *                     verifier.h
+ *
+ *     Assignment: Homework 6 - Universal Machine Program
+ *     Authors: Katie Yang (zyang11) and Pamela Melgar (pmelga01)
+ *     Date: November 24, 2021
+ *
+ *     Purpose: Interface for the load-time verifier. It scans segment 0
+ *              when the program is read and again after each load
+ *              program, and records in a bitmap which words are valid
+ *              instructions. A verified word can be run by
+ *              execute_verified, which leaves out every check that cannot
+ *              fail for it.
+ *
+ *     Success Output:
+ *              Depends on the function used
+ *
+ *     Failure output:
+ *              None; an unverified word is run by execute_instruction,
+ *              which fails on it as before
+ *
+ **************************************************************/
+
+#ifndef VERIFIER_H
+#define VERIFIER_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <assert.h>
+#include "memory_manager.h"
+#include "register_manager.h"
+#include "instruction_retrieval.h"
+#include "output_buffer.h"
+#include "input_buffer.h"
+
+/*The number of uint64_t a bitmap needs to cover length words*/
+#define VERIFIER_BITMAP_WORDS(length) (((size_t)(length) + 63) / 64)
+
+
+/*
+* verify_program
+* Purpose: To verify every word of segment 0
+* Input: the words of segment 0, their number, and a bitmap of
+*        VERIFIER_BITMAP_WORDS(length) words to fill in
+* Expected Output: the number of words that are not valid instructions.
+*                  Bit i of the bitmap is set if word i is one.
+* Note: the three register fields of a word are always in range, so a
+*       word is valid exactly when its opcode is one of the fourteen. The
+*       extension instructions are left to execute_instruction, which
+*       checks that they are enabled.
+*/
+uint32_t verify_program(const uint32_t *words, uint32_t length,
+                        uint64_t *bitmap);
+
+
+/*
+* verify_word
+* Purpose: To verify one word again after a store into segment 0
+* Input: the bitmap, the index of the word and the word now there
+* Expected Output: none, the word's bit is set or cleared
+* Note: word_index must be covered by the bitmap
+*/
+void verify_word(uint64_t *bitmap, uint32_t word_index, uint32_t word);
+
+
+/*
+* is_verified
+* Purpose: To tell the execution loop whether a word was verified
+* Input: a bitmap from verify_program and a word index it covers
+* Expected Output: true if the word is a valid instruction
+* Note: inline, since the loop asks once per instruction
+*/
+static inline bool is_verified(const uint64_t *bitmap, uint32_t word_index)
+{
+    return (bitmap[word_index / 64] >> (word_index % 64)) & 1;
+}
+
+
+/*
+* execute_verified
+* Purpose: To run a verified instruction the way execute_instruction does,
+*          but without the checks the verifier has already done: no handle
+*          or register index asserts and no invalid opcode case
+* Input: the decoded instruction, the Memory and Registers of the machine,
+*        and a pointer to the program counter (already advanced past this
+*        instruction)
+* Expected Output: true while the program should keep running, false once
+*                  it has executed a halt instruction
+* Note: info must come from a word is_verified accepts. What can only be
+*       known when the instruction runs is still checked: segment bounds
+*       and unmapped segments by the memory manager, output values, and
+*       division by zero, which traps as it does in execute_instruction.
+*/
+static inline bool execute_verified(const struct Info *info,
+                                    Memory all_segments,
+                                    Registers all_registers,
+                                    uint32_t *counter)
+{
+    uint32_t *reg = all_registers->registers;
+
+    switch ((Um_opcode)info->op) {
+    case CMOV:
+        if (reg[info->rC] != 0) {
+            reg[info->rA] = reg[info->rB];
+        }
+        break;
+    case SLOAD:
+        reg[info->rA] = get_word(all_segments, reg[info->rB],
+                                 reg[info->rC]);
+        break;
+    case SSTORE:
+        set_word(all_segments, reg[info->rA], reg[info->rB],
+                 reg[info->rC]);
+        break;
+    case ADD:
+        reg[info->rA] = reg[info->rB] + reg[info->rC];
+        break;
+    case MUL:
+        reg[info->rA] = reg[info->rB] * reg[info->rC];
+        break;
+    case DIV:
+        reg[info->rA] = reg[info->rB] / reg[info->rC];
+        break;
+    case NAND:
+        reg[info->rA] = ~(reg[info->rB] & reg[info->rC]);
+        break;
+    case HALT:
+        return false;
+    case ACTIVATE:
+        reg[info->rB] = map_segment(all_segments, reg[info->rC]);
+        break;
+    case INACTIVATE:
+        unmap_segment(all_segments, reg[info->rC]);
+        break;
+    case OUT:
+        assert(reg[info->rC] <= 255);
+        output_char(reg[info->rC]);
+        break;
+    case IN:
+        /*EOF reads back as all ones*/
+        reg[info->rC] = input_char();
+        break;
+    case LOADP:
+        duplicate_segment(all_segments, reg[info->rB]);
+        *counter = reg[info->rC];
+        break;
+    case LV:
+        reg[info->rA] = info->value;
+        break;
+    case BCOPY:
+    case FILL:
+        /*never verified, since whether they run depends on --ext*/
+        return execute_instruction(info, all_segments, all_registers,
+                                   counter);
+    }
+    return true;
+}
+
+#endif